@@ -0,0 +1,65 @@
+#ifndef CELLQUEUE_H
+#define CELLQUEUE_H
+
+#include <vector>
+#include <sys/types.h>
+
+// FIFO of field indices without duplicates, preallocated for every field of the grid
+// since a field can be queued only once at a time, the ring buffer never needs more slots than there are fields
+// like EntropyQueue it can cover a range of fields only
+class CellQueue
+{
+private:
+    std::vector<uint> ring;
+    std::vector<bool> queued;
+    uint firstField;
+    uint head = 0;
+    uint count = 0;
+public:
+    CellQueue(uint fieldCount, uint firstField = 0):
+        ring(fieldCount),
+        queued(fieldCount, false),
+        firstField(firstField)
+    {}
+
+    bool empty() const { return count == 0; }
+
+    void push(uint field)
+    {
+        if (queued[field - firstField])
+        { return; }
+        queued[field - firstField] = true;
+        uint tail = head + count;
+        if (tail >= ring.size())
+        { tail -= ring.size(); }
+        ring[tail] = field;
+        count++;
+    }
+
+    uint pop()
+    {
+        uint field = ring[head];
+        head++;
+        if (head == ring.size())
+        { head = 0; }
+        count--;
+        queued[field - firstField] = false;
+        return field;
+    }
+
+    void clear()
+    {
+        while (!empty())
+        { pop(); }
+        head = 0;
+    }
+
+    void resize(uint fieldCount)
+    {
+        clear();
+        ring.resize(fieldCount);
+        queued.resize(fieldCount, false);
+    }
+};
+
+#endif // CELLQUEUE_H
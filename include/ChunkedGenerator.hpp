@@ -0,0 +1,34 @@
+#ifndef CHUNKEDGENERATOR_H
+#define CHUNKEDGENERATOR_H
+
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "Grid.hpp"
+
+// generates a world of height x width tiles as chunks of at most chunkSize x chunkSize, row by row
+// only one chunk Grid exists at a time: it is written out as soon as it is done, only its last row and column are kept
+// to seed the top and left border of the following chunks, so memory is independent of the world height
+class ChunkedGenerator
+{
+private:
+    const std::vector<Tile>& tiles;
+    const int height;
+    const int width;
+    const int chunkSize;
+    GridSettings settings;
+    const int attempts; //per chunk, each with its own seed
+    std::vector<int> bottomRow; //[x] tile in the last row of the previous chunk row, -1 if there is none or it is undecided
+    std::vector<int> rightColumn; //[y in chunk] tile in the last column of the chunk to the left
+    std::unique_ptr<GridBase> grid; //resized for every chunk, the edge chunks may be smaller
+
+    GridBase& generateChunk(int chunkX, int chunkY, int chunkHeight, int chunkWidth, uint64_t seed, bool& success);
+
+public:
+    ChunkedGenerator(const std::vector<Tile>& tiles, int height, int width, int chunkSize, const GridSettings& settings, int attempts = 1);
+    // writes chunk (x, y) to <pathPrefix>_<y>_<x>.png, returns the number of chunks that ended in a contradiction
+    int run(const std::string& pathPrefix, uint64_t seed);
+};
+
+#endif // CHUNKEDGENERATOR_H
@@ -0,0 +1,119 @@
+#ifndef COMPACTGRID_H
+#define COMPACTGRID_H
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <random>
+#include <limits>
+#include <type_traits>
+#include <tuple>
+
+#include "Grid.hpp"
+
+// a grid for worlds too large for a Grid, which needs about 70 bytes per field:
+// here a field is a single byte (two for tilesets of more than 64 tiles) holding the tile it collapsed to or its state.
+// Only the frontier, the undecided fields that propagation touched, keeps a domain, weight sums and combined edge masks,
+// in a hash map that shrinks again as its fields collapse, so memory follows the size of the frontier instead of the grid
+// it makes the same decisions as a Grid with the edgeMasks propagator for the same seed,
+// but supports neither backtracking, the supportCounts propagator nor parallel regions
+template<uint Words>
+class CompactGrid : public GridBase
+{
+private:
+    typedef Domain<Words> Field;
+    typedef std::conditional_t<Words == 1, uint8_t, uint16_t> Cell;
+    static constexpr Cell UNTOUCHED = std::numeric_limits<Cell>::max(); //all tiles possible, nothing is stored about it
+    static constexpr Cell FRONTIER = UNTOUCHED - 1; //undecided, see frontier
+    static constexpr Cell CONTRADICTION = UNTOUCHED - 2;
+
+    struct WeightSums
+    {
+        uint weight;
+        double weightLogWeight;
+    };
+    struct FrontierField
+    {
+        Field domain;
+        std::array<Field, 4> combinedEdgeMasks; //none if not computed since the last change
+        WeightSums sums;
+        uint field;
+        uint heapSlot; //every frontier field is undecided, so it is always in the heap
+        bool queued; //in the propagation queue
+    };
+    struct HeapEntry
+    {
+        float entropy;
+        uint field; //ties go to the lower field index, like in EntropyQueue
+        uint frontierSlot;
+        bool operator<(const HeapEntry& other) const
+        { return std::tie(entropy, field) < std::tie(other.entropy, other.field); }
+    };
+
+    const std::vector<Tile>& tiles;
+    int height;
+    int width;
+    const Field allTiles;
+    const std::atomic<bool>* const cancel;
+    ProgressBuffer* const progress;
+    std::ostream& log;
+    const bool timePhases;
+    std::vector<std::array<Field, 4>> edgeMasks; //[tile][direction]
+    std::vector<uint> tileWeights;
+    std::vector<double> tileWeightLogWeights;
+    std::vector<float> logSums; //[sum of weights]: log(sum)
+    WeightSums initialWeights;
+    float initialEntropy; //of every untouched field
+    std::mt19937 randGen;
+    std::vector<Cell> cells;
+    std::vector<FrontierField> frontier; //slots are reused through freeSlots
+    std::vector<uint> freeSlots;
+    std::unordered_map<uint, uint> frontierSlots; //field -> slot in frontier
+    std::vector<HeapEntry> heap; //min-heap over the frontier
+    uint untouchedCursor = 0; //no field below it is untouched, fields only ever leave that state
+    std::vector<uint> queue; //FIFO of fields to update, drained by every propagation
+    size_t queueHead = 0;
+    std::vector<uint> constrainedFields;
+    bool constraintContradiction = false;
+    RunStats stats;
+    std::chrono::steady_clock::time_point lastLap;
+    std::chrono::steady_clock::time_point runStart;
+
+    int getIndex(const Position& pos) const { return pos.y * width + pos.x; }
+    Position getPosition(uint i) const { return Position{.x = (int) (i % width), .y = (int) (i / width)}; }
+    bool isValid(const Position& pos) const { return pos.x >= 0 && pos.x < width && pos.y >= 0 && pos.y < height; }
+    float calculateEntropy(const WeightSums& sums) const { return logSums[sums.weight] - sums.weightLogWeight / sums.weight; }
+    FrontierField& touch(uint field); //the frontier state of an undecided field, an untouched one joins the frontier
+    void settle(uint field, Cell cell); //the field leaves the frontier, collapsed or contradictory
+    void restrictField(uint field, const Field& allowed); //before run(), which propagates it
+    void removeWeights(FrontierField& state, const Field& removed);
+    void place(uint heapSlot, const HeapEntry& entry);
+    void siftUp(uint heapSlot);
+    void siftDown(uint heapSlot);
+    void updateEntropy(FrontierField& state);
+    Field combinedEdgeMask(const Position& pos, EdgeDirection edge);
+    void push(uint field);
+    void insertNeighbours(const Position& pos);
+    bool updateField(uint field);
+    bool fitsNeighbours(uint field); //whether some tile of the field fits its neighbours, also if it is decided
+    void propagateQueued();
+    int collapseOne();
+    void lap(std::chrono::nanoseconds& phase);
+    bool solve(); //run() without the last snapshot
+    void publishProgress(bool finished, bool success);
+
+public:
+    CompactGrid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings = GridSettings());
+    bool run() override;
+    void drawGrid(const std::string& path = "result.png") override;
+    void writeTileMap(const std::string& path = "result.wfcmap") override;
+    void requireNeighbour(int x, int y, EdgeDirection side, uint tile) override;
+    void applyConstraints(const Constraints& constraints) override;
+    int getTile(int x, int y) const override;
+    RunStats getStats() const override { return stats; }
+    void reset(uint64_t seed) override;
+    void resize(int height, int width, uint64_t seed) override;
+    size_t frontierSize() const { return frontierSlots.size(); }
+};
+
+#endif // COMPACTGRID_H
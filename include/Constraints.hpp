@@ -0,0 +1,47 @@
+#ifndef CONSTRAINTS_H
+#define CONSTRAINTS_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <functional>
+
+#include "Tile.hpp"
+#include "Position.hpp"
+
+// tiles that are decided before a grid runs, e.g. the authored parts of a level
+// a grid narrows all constrained fields first and propagates them together in a single pass when run() starts
+struct Constraints
+{
+    struct Region
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+        std::vector<uint64_t> allowed; //one bit per tile, like an edge mask
+    };
+
+    std::vector<std::pair<Position, uint>> fixed; //(field, tile)
+    std::vector<Region> regions; //every field within may only hold the allowed tiles, overlapping regions intersect
+    std::array<std::vector<uint64_t>, 4> borders; //[side]: the tiles allowed along that border of the grid, unconstrained if empty
+
+    void fix(int x, int y, uint tile) { fixed.push_back({Position{.x = x, .y = y}, tile}); }
+    void allowInRegion(int x, int y, int width, int height, const std::vector<uint>& tiles);
+    void allowAtBorder(EdgeDirection side, const std::vector<uint>& tiles);
+    bool empty() const;
+};
+
+// calls apply(field index, allowed tiles) for every field a constraint narrows: the borders first, then the regions, then the fixed fields
+// throws if a constraint lies outside of the grid or names a tile beyond tileCount
+void forEachConstraint(const Constraints& constraints, int height, int width, uint tileCount,
+    const std::function<void(uint field, const std::vector<uint64_t>& allowed)>& apply);
+
+// reads constraints from a text file, one per line, tiles are given by name or index, # starts a comment:
+// fix X Y TILE
+// region X Y WIDTH HEIGHT TILE,TILE,...
+// border top|left|right|bottom TILE,TILE,...
+Constraints readConstraints(const std::string& path, const std::vector<Tile>& tiles);
+
+#endif // CONSTRAINTS_H
@@ -0,0 +1,196 @@
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <bit>
+#include <sys/types.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// set of the tiles still possible in a field, Words * 64 bits wide
+// Grid is instantiated for the narrowest width that fits the tileset, so Domain<1> is a plain 64 bit value like bitset<64> was
+// wider domains combine 4 (AVX2) or 2 (SSE2) words per instruction
+template<uint Words>
+struct Domain
+{
+    alignas(Words % 4 == 0 ? 32 : (Words % 2 == 0 ? 16 : 8)) std::array<uint64_t, Words> words{};
+
+private:
+    struct And
+    {
+#if defined(__AVX2__)
+        __m256i operator()(__m256i a, __m256i b) const { return _mm256_and_si256(a, b); }
+#endif
+#if defined(__SSE2__)
+        __m128i operator()(__m128i a, __m128i b) const { return _mm_and_si128(a, b); }
+#endif
+        uint64_t operator()(uint64_t a, uint64_t b) const { return a & b; }
+    };
+    struct Or
+    {
+#if defined(__AVX2__)
+        __m256i operator()(__m256i a, __m256i b) const { return _mm256_or_si256(a, b); }
+#endif
+#if defined(__SSE2__)
+        __m128i operator()(__m128i a, __m128i b) const { return _mm_or_si128(a, b); }
+#endif
+        uint64_t operator()(uint64_t a, uint64_t b) const { return a | b; }
+    };
+    struct AndNot //a & ~b
+    {
+#if defined(__AVX2__)
+        __m256i operator()(__m256i a, __m256i b) const { return _mm256_andnot_si256(b, a); }
+#endif
+#if defined(__SSE2__)
+        __m128i operator()(__m128i a, __m128i b) const { return _mm_andnot_si128(b, a); }
+#endif
+        uint64_t operator()(uint64_t a, uint64_t b) const { return a & ~b; }
+    };
+
+    template<typename Op>
+    void combine(const Domain& other, Op op)
+    {
+#if defined(__AVX2__)
+        if constexpr (Words % 4 == 0)
+        {
+            for (uint i = 0; i < Words; i += 4)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&words[i]));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&other.words[i]));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(&words[i]), op(a, b));
+            }
+            return;
+        }
+#endif
+#if defined(__SSE2__)
+        if constexpr (Words % 2 == 0)
+        {
+            for (uint i = 0; i < Words; i += 2)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&words[i]));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&other.words[i]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&words[i]), op(a, b));
+            }
+            return;
+        }
+#endif
+        for (uint i = 0; i < Words; i++)
+        {
+            words[i] = op(words[i], other.words[i]);
+        }
+    }
+
+public:
+    static constexpr uint size() { return Words * 64; }
+
+    static Domain firstN(uint n) //the lowest n bits set
+    {
+        Domain domain;
+        for (uint i = 0; i < Words && n > 0; i++)
+        {
+            domain.words[i] = n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+            n = n >= 64 ? n - 64 : 0;
+        }
+        return domain;
+    }
+
+    static Domain fromWords(const std::vector<uint64_t>& src)
+    {
+        Domain domain;
+        for (uint i = 0; i < Words && i < src.size(); i++)
+        {
+            domain.words[i] = src[i];
+        }
+        return domain;
+    }
+
+    bool test(uint i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    bool operator[](uint i) const { return test(i); }
+    void set(uint i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(uint i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    void reset() { words.fill(0); }
+
+    uint count() const
+    {
+        uint count = 0;
+        for (uint64_t word : words)
+        {
+            count += std::popcount(word);
+        }
+        return count;
+    }
+
+    bool any() const
+    {
+#if defined(__AVX2__)
+        if constexpr (Words % 4 == 0)
+        {
+            __m256i acc = _mm256_setzero_si256();
+            for (uint i = 0; i < Words; i += 4)
+            {
+                acc = _mm256_or_si256(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&words[i])));
+            }
+            return !_mm256_testz_si256(acc, acc);
+        }
+#endif
+        uint64_t acc = 0;
+        for (uint64_t word : words)
+        {
+            acc |= word;
+        }
+        return acc != 0;
+    }
+    bool none() const { return !any(); }
+
+    uint first() const //index of the lowest set bit, size() if there is none
+    {
+        for (uint i = 0; i < Words; i++)
+        {
+            if (words[i] != 0)
+            { return i * 64 + std::countr_zero(words[i]); }
+        }
+        return size();
+    }
+
+    template<typename Func>
+    void forEach(Func func) const //calls func(index) for every set bit in ascending order
+    {
+        for (uint i = 0; i < Words; i++)
+        {
+            for (uint64_t bits = words[i]; bits != 0; bits &= bits - 1)
+            {
+                func(i * 64 + std::countr_zero(bits));
+            }
+        }
+    }
+
+    template<typename Func>
+    uint findIf(Func func) const //index of the first set bit for which func(index) returns true, size() if there is none
+    {
+        for (uint i = 0; i < Words; i++)
+        {
+            for (uint64_t bits = words[i]; bits != 0; bits &= bits - 1)
+            {
+                uint index = i * 64 + std::countr_zero(bits);
+                if (func(index))
+                { return index; }
+            }
+        }
+        return size();
+    }
+
+    Domain& operator&=(const Domain& other) { combine(other, And()); return *this; }
+    Domain& operator|=(const Domain& other) { combine(other, Or()); return *this; }
+    Domain& andNot(const Domain& other) { combine(other, AndNot()); return *this; }
+    Domain operator&(const Domain& other) const { Domain result = *this; return result &= other; }
+    Domain operator|(const Domain& other) const { Domain result = *this; return result |= other; }
+    Domain without(const Domain& other) const { Domain result = *this; return result.andNot(other); }
+    bool operator==(const Domain& other) const { return words == other.words; }
+    bool operator!=(const Domain& other) const { return words != other.words; }
+};
+
+#endif // DOMAIN_H
@@ -9,4 +9,9 @@ enum EdgeDirection
     bottom = 3
 };
 
+inline EdgeDirection opposite(EdgeDirection dir)
+{
+    return static_cast<EdgeDirection>(3 - dir);
+}
+
 #endif // EDGEDIRECTION_H
\ No newline at end of file
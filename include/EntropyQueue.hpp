@@ -0,0 +1,35 @@
+#ifndef ENTROPYQUEUE_H
+#define ENTROPYQUEUE_H
+
+#include <vector>
+#include <utility>
+#include <sys/types.h>
+
+// indexed binary min-heap of (entropy, field index), ties go to the lower field index
+// positions[field - firstField] is the slot of the field in the heap (-1 if not contained), so the entropy of any field can be changed in O(log n)
+// a queue can cover a range of fields only (firstField, firstField + fieldCount), e.g. the region of a RegionWorker
+class EntropyQueue
+{
+private:
+    std::vector<std::pair<float, uint>> heap;
+    std::vector<int> positions;
+    uint firstField;
+
+    bool less(uint a, uint b) const;
+    void place(uint slot, const std::pair<float, uint>& entry);
+    void siftUp(uint slot);
+    void siftDown(uint slot);
+
+public:
+    EntropyQueue(uint fieldCount, uint firstField = 0);
+    void resize(uint fieldCount); //keeps the capacity, empty until the next fill()
+    void fill(float entropy); //inserts all fields with the same entropy
+    void update(uint field, float entropy); //inserts the field if it isn't contained yet
+    void remove(uint field);
+    bool contains(uint field) const { return positions[field - firstField] != -1; }
+    bool empty() const { return heap.empty(); }
+    std::size_t size() const { return heap.size(); }
+    const std::pair<float, uint>& top() const { return heap.front(); }
+};
+
+#endif // ENTROPYQUEUE_H
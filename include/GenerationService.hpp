@@ -0,0 +1,44 @@
+#ifndef GENERATIONSERVICE_H
+#define GENERATIONSERVICE_H
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+// keeps tilesets loaded and generates grids on a thread pool for requests arriving line by line, see README for the protocol
+// every request is scheduled as soon as it is read, so a client may send many before reading any response;
+// responses are written in the order the requests finish, tagged with the request's id
+class GenerationService
+{
+private:
+    struct Connection;
+
+    std::map<std::string, std::unique_ptr<const std::vector<Tile>>> tilesets; //by tileset path, "" for all tiles
+    std::mutex tilesetsMutex; //loading touches the edges shared by all tiles, only one tileset is loaded at a time
+    const std::string tileCache; //prefix of the compiled tilesets, none if empty
+    const std::string outputDir; //the out paths of the requests are below it, the working directory if empty
+    std::ostream quietLog; //the grids of the requests log into it, their messages would end up between the responses
+    const GridSettings settings;
+    ThreadPool pool;
+
+    const std::vector<Tile>& getTileset(const std::string& path);
+    bool isLoaded(const std::string& tilesetPath);
+    void handle(const std::shared_ptr<Connection>& connection, const std::string& line, uint64_t number);
+    void serveConnection(const std::shared_ptr<Connection>& connection);
+
+public:
+    GenerationService(const GridSettings& settings, int threadCount, const std::string& tileCache = "", const std::string& outputDir = "");
+    void preload(const std::string& tilesetPath);
+    // answers the requests read from inFd on outFd until the input ends, returns once all of them are answered
+    void serve(int inFd, int outFd);
+    // accepts clients on a unix domain socket, each one is read on its own thread and served by the shared pool, never returns
+    // a socket left at socketPath by an earlier service is replaced, any other file is not
+    [[noreturn]] void listen(const std::string& socketPath);
+};
+
+#endif // GENERATIONSERVICE_H
@@ -2,53 +2,251 @@
 #define GRID_H
 
 #include <vector>
-#include <unordered_set>
-#include <bitset>
 #include <functional>
+#include <memory>
 #include <random>
+#include <cstdint>
+#include <optional>
+#include <atomic>
+#include <string>
+#include <chrono>
+#include <iostream>
 
 #include "Tile.hpp"
+#include "Domain.hpp"
 #include "Position.hpp"
+#include "EntropyQueue.hpp"
+#include "CellQueue.hpp"
+#include "RegionWorker.hpp"
+#include "GridCounters.hpp"
+#include "TilesetAnalysis.hpp"
+#include "Constraints.hpp"
+#include "Topology.hpp"
+#include "Progress.hpp"
 
-class Grid
+enum class Propagator
 {
+    edgeMasks = 0, //ANDs the combined edge masks of all four neighbours of a changed field
+    supportCounts //AC-4: counts the compatible tiles in each neighbour, only touches the removed tiles
+};
+
+// which undecided field collapses next
+enum class Heuristic
+{
+    entropy = 0, //lowest Shannon entropy of the tile weights, ties go to the lower field index
+    remainingValues, //fewest possible tiles (MRV), ties are broken by a little noise instead of the field index
+    scanline, //the first undecided field in row order, O(1) per collapse
+    frontier //the undecided neighbours of decided fields in the order they were decided, so the decided area grows as one patch
+};
+
+struct GridSettings
+{
+    Propagator propagator = Propagator::edgeMasks;
+    Heuristic heuristic = Heuristic::entropy;
+    int backtrackBudget = 0; //how many contradictions may be undone by banning the last decision, 0 aborts on the first one
+    std::optional<uint64_t> seed; //seeded from the clock if not set
+    const std::atomic<bool>* cancel = nullptr; //run() gives up between two collapses once this is set
+    std::ostream* log = &std::cout; //where run() reports contradictions and backtracks, must outlive the grid
+    ProgressBuffer* progress = nullptr; //run() publishes snapshots into it between collapses and once it returns, see ProgressMonitor
+    int regionThreads = 1; //more than 1 splits the grid into horizontal strips that are collapsed in parallel first, see RegionWorker
+    int seamBand = 2; //rows on each side of a strip border that are only collapsed sequentially afterwards, 1 leaves too little room to fill them
+    bool cacheEdgeMasks = true; //edgeMasks only: false drops the combined edge mask cache (4 domains per field) where the mask tables apply
+    bool timePhases = false; //measure collapse and propagation separately in RunStats, costs two clock reads per collapse
+    bool pruneTiles = false; //start every field with the domain of its class in a TilesetAnalysis instead of all tiles
+    bool periodic = false; //the borders wrap around, see Topology, not with regions or a CompactGrid
+    bool compact = false; //makeGrid returns a CompactGrid, a byte per field instead of ~70 for huge grids, edgeMasks without backtracking only
+};
+
+// what happened during run()
+struct RunStats
+{
+    std::chrono::nanoseconds collapse{0}; //entropy updates, picking the field and deciding its tile
+    std::chrono::nanoseconds propagation{0}; //including backtracking and the parallel regions
+    int backtracks = 0;
+    int stripFailures = 0; //contradictions inside the parallel regions, each restarts its strip up to STRIP_RETRIES times
+    GridCounters counters; //all 0 unless built with WFC_STATS
+};
+
+// combined edge masks are looked up per byte of a domain while the tables for all four directions fit in here, i.e. for up to 256 tiles
+// the tables fill cache misses, wider tilesets loop over the tiles instead
+const size_t MAX_MASK_TABLE_BYTES = 1 << 20;
+
+// the seams are fixed on both sides when they are collapsed, which needs a few backtracks now and then
+const int DEFAULT_SEAM_BACKTRACKS = 1000;
+
+// interface of a Grid independent of its domain width
+class GridBase
+{
+public:
+    virtual ~GridBase() = default;
+    virtual bool run() = 0; //false if the grid ran into a contradiction or was cancelled
+    virtual void drawGrid(const std::string& path = "result.png") = 0;
+    // only the tile index of every field, see TileMap, much smaller and faster to write than a png of a large grid
+    virtual void writeTileMap(const std::string& path = "result.wfcmap") = 0;
+    // restricts the field to the tiles that fit next to the given tile, which lies outside of the grid on that side
+    // applied before run(), all restrictions are propagated together when it starts
+    virtual void requireNeighbour(int x, int y, EdgeDirection side, uint tile) = 0;
+    // narrows the fields as required, like requireNeighbour all of them are propagated in one pass when run() starts
+    // fields the constraints leave without a tile make run() fail right away
+    virtual void applyConstraints(const Constraints& constraints) = 0;
+    virtual int getTile(int x, int y) const = 0; //index of the tile the field collapsed to, -1 if it is undecided or contradictory
+    virtual RunStats getStats() const = 0; //the timings stay 0 unless GridSettings::timePhases is set
+    // undoes run() and requireNeighbour() as if the grid was just made with this seed, reusing all storage:
+    // back-to-back runs and retries don't allocate once the vectors reached their size
+    virtual void reset(uint64_t seed) = 0;
+    // like reset for another size, only allocates when the grid gets larger than it ever was
+    virtual void resize(int height, int width, uint64_t seed) = 0;
+};
+
+// Words: 64 bit words per domain, the narrowest that fits the tileset is picked by makeGrid
+template<uint Words>
+class Grid : public GridBase
+{
+    friend class RegionWorker<Words>;
 private:
+    typedef Domain<Words> Field;
+    
     const std::vector<Tile>& tiles;
-    const int height;
-    const int width;
+    int height; //only changed by resize
+    int width;
+    const Propagator propagator;
+    const Heuristic heuristic;
+    const int backtrackBudget;
+    const Field allTiles;
+    const std::atomic<bool>* const cancel;
+    ProgressBuffer* const progress;
+    std::ostream& log;
+    const int regionThreads;
+    const int seamBand;
+    const bool timePhases;
+    const bool cacheEdgeMasks;
+    const bool pruneTiles;
+    struct ClassDomains
+    {
+        bool analysed = false;
+        bool pruning = false; //some class domain lacks a tile
+        std::array<std::array<Field, 3>, 3> domains; //[row class][column class] of the TilesetAnalysis
+    };
+    std::vector<ClassDomains> layoutDomains; //pruneTiles only: [row layout * AXIS_LAYOUTS + column layout], analysed when first needed
+    const ClassDomains* classDomains = nullptr; //pruneTiles only: the entry of layoutDomains for the current size
+    Topology topology; //resized with the grid
+    std::vector<std::array<Field, 4>> edgeMasks; //[tile][direction], copied from the tiles to have the masks at this width and close together
+    std::vector<uint> tileWeights;
+    std::vector<double> tileWeightLogWeights; //[tile]: weight * log(weight)
+    std::vector<float> logSums; //[sum of weights]: log(sum), the weights of a field always add up to at most the sum over all tiles
+    struct WeightSums
+    {
+        uint weight;
+        double weightLogWeight;
+    };
+    WeightSums initialWeights; //of a field where all tiles are possible
+    std::vector<WeightSums> weightSums; //[field]: sums over the tiles still possible, updated by every removal so entropies need no loop
     std::mt19937 randGen;
-    std::vector<std::bitset<MAX_TILES>> fields;
-    std::vector<std::pair<float, uint>> entropies;
+    std::vector<Field> fields;
+    EntropyQueue entropies; //entropy and remainingValues only: contains the fields that are not determined yet
+    uint scanCursor = 0; //scanline and frontier: no field below it is undecided, backtracking moves it back
+    std::vector<uint> frontier; //frontier only: FIFO of fields next to decided ones, from frontierHead on
+    size_t frontierHead = 0;
+    std::vector<bool> inFrontier;
     std::vector<bool> dirtyEntropies;
-    std::vector<std::array<std::bitset<MAX_TILES>, 4>> combinedEdgeMasks;
+    std::vector<uint> dirtyFields; //stack of the fields marked in dirtyEntropies
+    std::vector<Field> maskTable; //[(direction * maskTableSlices + byte of the domain) * 256 + value of the byte]: OR of the edge masks of those tiles
+    uint maskTableSlices = 0;
+    std::vector<uint16_t> maskClasses; //without a maskTable: [direction * tiles + tile] -> its class, tiles whose edge masks on that side are equal
+    std::array<std::vector<Field>, 4> classMasks; //[direction][class]: the edge mask shared by the tiles of the class
+    std::vector<std::array<Field, 4>> combinedEdgeMasks; //emptied by clearCache, not allocated without GridSettings::cacheEdgeMasks
+    CellQueue dirtyPositions; //worklist of propagateChanges
+    std::vector<uint16_t> supports; //supportCounts only: [field][direction][tile] -> number of tiles in the neighbour that fit
+    std::vector<uint16_t> initialSupports; //supportCounts only: [direction][tile], the counts of a field with a neighbour before anything was removed
+    std::vector<uint16_t> supportedTiles; //supportCounts only: the edge masks as lists of tiles, see supportedStarts
+    std::vector<uint> supportedStarts; //supportCounts only: [tile * 4 + direction] -> first of its tiles in supportedTiles, one more entry ends the last list
+    std::vector<std::pair<uint, uint>> removals; //supportCounts only: stack of (field, tile) whose removal still has to be propagated
     
+    struct Decision
+    {
+        size_t trailSize; //trail entries before the collapse
+        uint field;
+        uint tile;
+    };
+    std::vector<std::pair<uint, Field>> trail; //backtracking only: (field, domain before the change), at most one entry per field and decision
+    std::vector<uint> trailStamps; //stamp of the decision that last recorded the field in the trail
+    uint stamp = 0;
+    std::vector<Decision> decisions;
+    int backtracks = 0;
+    std::vector<uint> constrainedFields; //edgeMasks only: fields narrowed by requireNeighbour, their neighbours are updated when run() starts
+    bool constraintContradiction = false;
+    RunStats stats;
+    std::chrono::steady_clock::time_point lastLap;
+    std::chrono::steady_clock::time_point runStart;
+    uint64_t waveChanges = 0; //fields changed by the current propagation, only counted with WFC_STATS
+    
+    void allocate(); //sizes the storage of every field for height * width
+    void initState(); //every field undecided, nothing queued, recorded or counted
     Position getPosition(int i) const;
-    void forEachInField(const std::bitset<MAX_TILES>& field, const std::function<void(const Tile&)>& func);
-    uint selectFromField(const std::bitset<MAX_TILES>& field, const std::function<bool(const Tile&)>& func);
-    float calculateEntropy(const std::bitset<MAX_TILES>& field);
-    float checkEntropy(int i);
+    uint selectFromField(const Field& field, const std::function<bool(const Tile&)>& func);
+    float calculateEntropy(uint field) const;
+    void removeWeight(uint field, uint tile);
+    void removeWeights(uint field, const Field& removed);
+    void addWeights(uint field, const Field& added);
+    void updateEntropies();
+    void restrictField(uint field, const Field& allowed); //narrows the field before run(), which propagates it
+    void applyClassDomains();
+    void updateFrontier();
+    int selectField(); //the next field to collapse by the heuristic, -1 once all are determined
+    int nextInScanline();
     void clearCache(uint index);
+    void clearMaskCache(uint index);
+    void buildMaskTable();
+    void buildMaskClasses();
+    Field combineEdgeMasks(const Field& field, EdgeDirection edge) const;
     int collapseOne();
-    void collapseField(std::bitset<MAX_TILES>& field);
-    void insertNeighbours(std::unordered_set<int>& set, const Position& pos) const;
-    void propagateChanges(Position pos);
+    Field collapseField(uint field, std::mt19937& rng); //picks a tile by weight, returns the collapsed domain without storing it
+    void insertNeighbours(uint field);
+    void propagateChanges(uint field);
+    void propagateQueued();
+    uint16_t& support(uint field, EdgeDirection dir, uint tile);
+    template<typename Func>
+    void forEachSupported(uint tile, EdgeDirection dir, Func func) const;
+    void initSupports();
+    void removeUnsupported();
+    void queueRemovals(uint field, const Field& removed);
+    void propagateRemovals();
+    void recordChange(uint field);
+    void discardPending();
+    void unwind(size_t trailSize);
+    int backtrack();
+    void propagateOrBacktrack(int collapsed);
+    void runRegions();
+    void lap(std::chrono::nanoseconds& phase);
+    bool solve(); //run() without the last snapshot
+    void publishProgress(bool finished, bool success);
     int getIndex(const Position& pos) const;
     // int getIndex(Position pos) const;
-    bool isValid(const Position& pos) const;
     // float getField(Position pos);
     
 public:
-    Grid(std::vector<Tile>& tiles, int height, int width);
+    Grid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings = GridSettings());
     Grid(Grid& other) = delete;
-    Grid(Grid&& other) = delete;
+    Grid(Grid&& other) = default; //e.g. to keep grids in a pool, bound to its tiles and settings, so it can't be assigned
     Grid& operator=(const Grid&) = delete;
     Grid& operator=(const Grid&&) = delete;
-    void run();
-    void drawGrid();
-    bool updateField(Position pos);
-    bool inBounds(Position pos);
-    std::bitset<MAX_TILES> combinedEdgeMask(Position pos, EdgeDirection edge);
-    std::vector<std::bitset<MAX_TILES>>::iterator operator[](std::size_t i);
+    void reset(uint64_t seed) override;
+    void resize(int height, int width, uint64_t seed) override;
+    bool run() override;
+    void drawGrid(const std::string& path = "result.png") override;
+    void writeTileMap(const std::string& path = "result.wfcmap") override;
+    void requireNeighbour(int x, int y, EdgeDirection side, uint tile) override;
+    void applyConstraints(const Constraints& constraints) override;
+    int getTile(int x, int y) const override;
+    RunStats getStats() const override;
+    bool updateField(uint field);
+    bool fitsNeighbours(uint field); //whether some tile of the field fits its neighbours, also if it is decided
+    Field combinedEdgeMask(uint field, EdgeDirection edge); //allTiles for Topology::NO_NEIGHBOUR
+    typename std::vector<Field>::iterator operator[](std::size_t i);
 };
 
+// throws the error the grids raise for settings they don't support, independent of the grid size, without building one
+void validateSettings(const GridSettings& settings, uint tileCount);
+std::unique_ptr<GridBase> makeGrid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings = GridSettings());
+
 #endif // GRID_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef GRIDCOUNTERS_H
+#define GRIDCOUNTERS_H
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// counts what the hot paths of a Grid do, only when built with WFC_STATS (make STATS=1)
+// otherwise COUNT() compiles to nothing and all counters stay 0
+#ifdef WFC_STATS
+#define COUNT(statement) statement
+#else
+#define COUNT(statement)
+#endif
+
+struct GridCounters
+{
+    #ifdef WFC_STATS
+    static constexpr bool enabled = true;
+    #else
+    static constexpr bool enabled = false;
+    #endif
+    static constexpr int WAVE_BUCKETS = 24;
+
+    uint64_t decisions = 0; //fields collapsed by a random choice
+    uint64_t propagatedSingletons = 0; //fields narrowed down to a single tile by propagation
+    uint64_t updateCalls = 0; //edgeMasks: fields recomputed from their neighbours
+    uint64_t updateChanges = 0; //edgeMasks: recomputed fields that actually lost tiles
+    uint64_t tileRemovals = 0; //supportCounts: tiles removed because a count dropped to 0
+    uint64_t maskCacheHits = 0; //combined edge masks taken from the cache
+    uint64_t maskRecomputes = 0; //combined edge masks computed from the tables or the tiles
+    uint64_t entropyRecomputes = 0;
+    std::array<uint64_t, WAVE_BUCKETS> waves{}; //[0]: propagations after a decision that changed no field, [i]: that changed [2^(i-1), 2^i) fields
+
+    void recordWave(uint64_t changedFields)
+    {
+        int bucket = std::bit_width(changedFields);
+        waves[bucket < WAVE_BUCKETS ? bucket : WAVE_BUCKETS - 1]++;
+    }
+
+    GridCounters& operator+=(const GridCounters& other)
+    {
+        decisions += other.decisions;
+        propagatedSingletons += other.propagatedSingletons;
+        updateCalls += other.updateCalls;
+        updateChanges += other.updateChanges;
+        tileRemovals += other.tileRemovals;
+        maskCacheHits += other.maskCacheHits;
+        maskRecomputes += other.maskRecomputes;
+        entropyRecomputes += other.entropyRecomputes;
+        for (int i = 0; i < WAVE_BUCKETS; i++)
+        {
+            waves[i] += other.waves[i];
+        }
+        return *this;
+    }
+};
+
+#endif // GRIDCOUNTERS_H
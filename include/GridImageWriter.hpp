@@ -0,0 +1,35 @@
+#ifndef GRIDIMAGEWRITER_H
+#define GRIDIMAGEWRITER_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <png++/png.hpp>
+
+#include "Tile.hpp"
+
+// streams a grid of tiles into a png one scanline at a time, the whole image never exists in memory
+// the tiles of a grid row are only asked for when its first scanline is due, so memory stays at one row of tiles plus one scanline
+class GridImageWriter : public png::generator<png::rgb_pixel, GridImageWriter>
+{
+public:
+    typedef std::function<void(int y, std::vector<const Tile*>& row)> RowSource; //fills row with the width tiles of grid row y
+
+    GridImageWriter(int height, int width, uint tileHeight, uint tileWidth, RowSource rowSource);
+    void write(const std::string& path);
+    png::byte* get_next_row(png::uint_32 pos); //called by png::generator
+    void reset(size_t) {}
+
+private:
+    const int height;
+    const int width;
+    const uint tileHeight;
+    const uint tileWidth;
+    RowSource rowSource;
+    std::vector<const Tile*> tileRow;
+    int currentRow = -1; //grid row in tileRow
+    std::vector<png::rgb_pixel> scanline;
+};
+
+#endif // GRIDIMAGEWRITER_H
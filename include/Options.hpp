@@ -0,0 +1,24 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+#include "Grid.hpp"
+#include "TileEdge.hpp"
+
+// options are given as --name=value anywhere on the command line, everything else is positional
+void parseArguments(int argc, char *argv[], std::vector<std::string>& positional, std::map<std::string, std::string>& options);
+Propagator parsePropagator(const std::map<std::string, std::string>& options);
+Heuristic parseHeuristic(const std::map<std::string, std::string>& options);
+// the options shared by main and bench: propagator, heuristic, backtracks, regions, seam, mask-cache, prune and compact
+GridSettings parseGridSettings(const std::map<std::string, std::string>& options);
+// the options that change how tiles are loaded, applied before createTiles: edge-tolerance
+void parseTileOptions(const std::map<std::string, std::string>& options);
+// a seed option or request field, 0 to 2^64-1 in decimal
+uint64_t parseSeed(const std::string& value);
+std::vector<std::string> splitList(const std::string& list, char separator = ',');
+
+#endif // OPTIONS_H
@@ -0,0 +1,16 @@
+#ifndef OVERLAPPINGMODEL_H
+#define OVERLAPPINGMODEL_H
+
+#include <string>
+#include <vector>
+
+#include "Tile.hpp"
+
+// the overlapping model: every distinct n x n pattern of a sample image becomes a tile of a single pixel, its top left one,
+// weighted by how often it occurs. Two patterns fit next to each other if they agree where they overlap when shifted by one pixel,
+// so the overlap on each side is interned as a TileEdge and Tile::matchTiles buckets them just like the edges of hand made tiles
+// symmetry: how many of the 8 rotations and reflections of every pattern are added, 1 keeps the sample's orientation only
+// periodicInput: patterns wrap around the borders of the sample
+std::vector<Tile> createPatternTiles(const std::string& samplePath, int n = 3, int symmetry = 8, bool periodicInput = true);
+
+#endif // OVERLAPPINGMODEL_H
@@ -0,0 +1,45 @@
+#ifndef PARALLELRUNNER_H
+#define PARALLELRUNNER_H
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <string>
+
+#include "Grid.hpp"
+#include "ThreadPool.hpp"
+
+struct Attempt
+{
+    uint64_t seed = 0;
+    bool success = false;
+    std::chrono::milliseconds duration{0};
+    std::unique_ptr<GridBase> grid; //only kept for the winner of a race
+};
+
+struct RaceResult
+{
+    Attempt winner; //success is false if every attempt ran into a contradiction
+    int attemptsStarted = 0;
+    int contradictions = 0;
+};
+
+// runs independent Grid attempts on a thread pool, the attempts only share the tiles, read-only
+// attempt i is seeded with firstSeed + i, so any result can be reproduced with a single sequential run
+class ParallelRunner
+{
+private:
+    const std::vector<Tile>& tiles;
+    ThreadPool pool;
+
+public:
+    ParallelRunner(const std::vector<Tile>& tiles, int threadCount);
+    // starts up to maxAttempts attempts until one finishes without contradiction, then cancels the others
+    // settings.cancel stops the whole race, the winner's success is false then
+    RaceResult race(int height, int width, GridSettings settings, uint64_t firstSeed, int maxAttempts);
+    // runs all attempts to the end, successful grids are drawn to <pathPrefix><seed>.png as soon as they are done
+    std::vector<Attempt> batch(int height, int width, GridSettings settings, uint64_t firstSeed, int count, const std::string& pathPrefix);
+    int threadCount() const { return pool.size(); }
+};
+
+#endif // PARALLELRUNNER_H
@@ -0,0 +1,172 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <sys/types.h>
+
+#include "TileMap.hpp"
+
+// the state of a running grid at one point in time
+struct ProgressSnapshot
+{
+    uint64_t sequence = 0; //counts the snapshots of a ProgressBuffer, a gap means the reader skipped some
+    int height = 0; //of the grid
+    int width = 0;
+    int scale = 1; //the cells hold every scale-th field of every scale-th row, see ProgressBuffer
+    int rows = 0; //of cells
+    int columns = 0;
+    uint cellBytes = 1; //1 for up to 254 tiles, 2 beyond
+    std::vector<uint8_t> cells; //rows * columns cells encoded like in a TileMap, a few bytes per field even for huge grids
+    uint decided = 0; //fields of the grid with a single tile left
+    int backtracks = 0;
+    std::chrono::nanoseconds elapsed{0}; //since run() started
+    bool finished = false; //the last snapshot of a run, taken after it returned
+    bool success = false; //finished only: what run() returned
+
+    int getTile(int column, int row) const //tile index, UNDECIDED_TILE or CONTRADICTION_TILE
+    {
+        size_t i = (size_t) row * columns + column;
+        uint cell = cells[i * cellBytes];
+        uint undecided = 0xFF;
+        if (cellBytes == 2)
+        {
+            uint16_t wide;
+            std::memcpy(&wide, &cells[i * 2], 2);
+            cell = wide;
+            undecided = 0xFFFF;
+        }
+        return cell == undecided ? UNDECIDED_TILE : cell == undecided - 1 ? CONTRADICTION_TILE : (int) cell;
+    }
+};
+
+// triple buffer between a running grid and one reader: the grid fills the back buffer and swaps it with the middle one,
+// the reader swaps the middle one with its front buffer. Neither side ever waits for the other,
+// a reader that falls behind only sees the newest snapshot, the grid never waits for a reader at all
+class ProgressBuffer
+{
+private:
+    static constexpr uint FRESH = 4; //set on middle while it holds a snapshot the reader hasn't taken yet
+
+    std::array<ProgressSnapshot, 3> buffers;
+    alignas(64) std::atomic<uint> middle{1};
+    uint back = 0; //only used by the grid
+    uint front = 2; //only used by the reader
+    const std::chrono::nanoseconds interval;
+    std::chrono::steady_clock::time_point nextSnapshot; //only used by the grid
+    uint callsSinceClock = 0;
+    uint64_t sequence = 0;
+    const int scale;
+
+public:
+    // scale > 1 downsamples the snapshots, e.g. to keep previews of huge grids small, the counts still cover every field
+    ProgressBuffer(std::chrono::milliseconds snapshotInterval = std::chrono::milliseconds(100), int snapshotScale = 1):
+        interval(snapshotInterval),
+        scale(std::max(snapshotScale, 1))
+    {}
+
+    // grid side: whether a snapshot is due, reads the clock only every 64 calls so it can be asked after every collapse
+    bool due()
+    {
+        if (++callsSinceClock < 64)
+        { return false; }
+        callsSinceClock = 0;
+        auto now = std::chrono::steady_clock::now();
+        if (now < nextSnapshot)
+        { return false; }
+        nextSnapshot = now + interval;
+        return true;
+    }
+    // grid side: fills the cells and the decided count of the back buffer, tileAt(field) returns a tile index,
+    // UNDECIDED_TILE or CONTRADICTION_TILE. The rest of the snapshot is up to the grid before it calls publish()
+    template<typename TileAt>
+    ProgressSnapshot& fill(int height, int width, uint tileCount, TileAt tileAt)
+    {
+        ProgressSnapshot& snapshot = buffers[back];
+        snapshot.height = height;
+        snapshot.width = width;
+        snapshot.scale = scale;
+        snapshot.rows = (height + scale - 1) / scale;
+        snapshot.columns = (width + scale - 1) / scale;
+        snapshot.cellBytes = tileCount <= 254 ? 1 : 2;
+        snapshot.cells.resize((size_t) snapshot.rows * snapshot.columns * snapshot.cellBytes);
+        snapshot.decided = 0;
+        uint8_t* cell = snapshot.cells.data();
+        for (int y = 0; y < height; y++)
+        {
+            bool sampledRow = y % scale == 0;
+            for (int x = 0; x < width; x++)
+            {
+                int tile = tileAt((uint) (y * width + x));
+                snapshot.decided += tile >= 0;
+                if (!sampledRow || x % scale != 0)
+                { continue; }
+                //truncated to the cell width like in a TileMap
+                if (snapshot.cellBytes == 1)
+                {
+                    *cell++ = uint8_t(tile);
+                }
+                else
+                {
+                    uint16_t wide = uint16_t(tile);
+                    std::memcpy(cell, &wide, 2);
+                    cell += 2;
+                }
+            }
+        }
+        return snapshot;
+    }
+    void publish() //makes the back buffer the newest snapshot
+    {
+        buffers[back].sequence = ++sequence;
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    // reader side: the newest snapshot or nullptr if there was none since the last call, valid until the next call
+    const ProgressSnapshot* latest()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        { return nullptr; }
+        front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+        return &buffers[front];
+    }
+};
+
+// hands the snapshots of a grid to an observer on a thread of its own, so a slow observer (e.g. an editor drawing a preview)
+// never slows the generation down. Point GridSettings::progress and GridSettings::cancel at getBuffer() and getCancel()
+class ProgressMonitor
+{
+public:
+    typedef std::function<bool(const ProgressSnapshot&)> Observer; //false cancels the run
+
+private:
+    ProgressBuffer buffer;
+    std::atomic<bool> cancelled{false};
+    const Observer observer;
+    const std::chrono::milliseconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;
+
+    void watch();
+
+public:
+    ProgressMonitor(Observer observer, std::chrono::milliseconds interval = std::chrono::milliseconds(100), int scale = 1);
+    ProgressMonitor(const ProgressMonitor&) = delete;
+    ~ProgressMonitor(); //hands the last snapshot to the observer before it returns
+    ProgressBuffer* getBuffer() { return &buffer; }
+    const std::atomic<bool>* getCancel() const { return &cancelled; }
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); } //run() returns false after the current collapse
+};
+
+#endif // PROGRESS_H
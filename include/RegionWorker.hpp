@@ -0,0 +1,90 @@
+#ifndef REGIONWORKER_H
+#define REGIONWORKER_H
+
+#include <vector>
+#include <random>
+#include <atomic>
+
+#include "Domain.hpp"
+#include "Position.hpp"
+#include "EntropyQueue.hpp"
+#include "CellQueue.hpp"
+#include "SpscQueue.hpp"
+#include "GridCounters.hpp"
+
+template<uint Words>
+class Grid;
+
+// state shared by all RegionWorkers of a grid
+struct RegionSync
+{
+    std::atomic<bool> failed{false};
+    std::atomic<long> pending{0}; //fields handed to another region and not processed yet
+    std::atomic<int> idle{0};
+    int workers = 0;
+    const std::atomic<bool>* cancel = nullptr;
+    std::atomic<int> stripFailures{0}; //contradictions within a strip, see RunStats
+};
+
+// how often a strip starts over after a contradiction before the whole run fails
+const int STRIP_RETRIES = 3;
+
+// collapses and propagates within a horizontal strip of a Grid on its own thread
+// only the owner writes the fields of its strip, neighbours in other strips are read word by word through atomic_ref,
+// which is safe as domains only shrink while the workers run: a torn read is a superset of the new domain
+// a changed field next to another strip is handed to that strip's owner through a lock-free queue,
+// decisions are only made outside of the seam band, the band is collapsed sequentially by the Grid afterwards
+// a strip that runs into a contradiction starts over on its own with a fresh seed, the others keep going
+template<uint Words>
+class RegionWorker
+{
+private:
+    typedef Domain<Words> Field;
+    enum { above = 0, below = 1 };
+
+    Grid<Words>& grid;
+    RegionSync& sync;
+    const uint firstField; //owned fields
+    const uint endField;
+    const uint firstCollapse; //fields that may be collapsed, the owned fields without the seam band
+    const uint endCollapse;
+    std::mt19937 randGen;
+    EntropyQueue entropies;
+    CellQueue dirtyPositions;
+    std::vector<bool> dirtyEntropies;
+    std::vector<uint> dirtyFields;
+    SpscQueue* inbound[2] = {nullptr, nullptr};
+    SpscQueue* outbound[2] = {nullptr, nullptr};
+    std::vector<uint> overflow[2]; //handed off fields that did not fit into the outbound queue yet
+    GridCounters counters; //added to the Grid's after the workers joined
+    std::vector<Field> startFields; //the owned fields and their weights when the regions started, what a retry starts from
+    std::vector<typename Grid<Words>::WeightSums> startWeights;
+    long received = 0; //fields taken from the inbound queues and not propagated yet, still counted in RegionSync::pending
+    int retries = 0;
+
+    bool owns(uint field) const { return field >= firstField && field < endField; }
+    Field load(uint field) const;
+    void store(uint field, const Field& value);
+    void send(uint field);
+    void flushOverflow();
+    long receive();
+    bool hasInbound() const;
+    Field combinedEdgeMask(uint field, EdgeDirection edge);
+    bool updateField(uint field);
+    void markChanged(uint field);
+    void insertNeighbours(uint field);
+    void propagate();
+    void updateEntropies();
+    int collapseOne();
+    void queueEntropies();
+    void restart();
+    void work();
+
+public:
+    RegionWorker(Grid<Words>& grid, RegionSync& sync, uint firstRow, uint endRow, uint firstCollapseRow, uint endCollapseRow, uint64_t seed);
+    void connect(SpscQueue* fromAbove, SpscQueue* toAbove, SpscQueue* fromBelow, SpscQueue* toBelow);
+    void run(); //returns when all regions are done or one of them ran into a contradiction
+    const GridCounters& getCounters() const { return counters; }
+};
+
+#endif // REGIONWORKER_H
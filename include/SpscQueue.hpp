@@ -0,0 +1,58 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <vector>
+#include <atomic>
+#include <sys/types.h>
+
+// lock-free bounded FIFO of field indices between exactly one producer and one consumer thread
+// everything the producer wrote before push() is visible to the consumer after the matching pop()
+class SpscQueue
+{
+private:
+    std::vector<uint> ring;
+    const uint mask;
+    alignas(64) std::atomic<uint> head{0}; //next slot to pop, written by the consumer
+    alignas(64) std::atomic<uint> tail{0}; //next slot to push, written by the producer
+
+    static uint roundUp(uint capacity)
+    {
+        uint size = 1;
+        while (size < capacity)
+        { size *= 2; }
+        return size;
+    }
+
+public:
+    SpscQueue(uint capacity):
+        ring(roundUp(capacity)),
+        mask(ring.size() - 1)
+    {}
+
+    bool push(uint field) //false if the queue is full
+    {
+        uint t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == ring.size())
+        { return false; }
+        ring[t & mask] = field;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(uint& field) //false if the queue is empty
+    {
+        uint h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        { return false; }
+        field = ring[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+};
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,37 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+// fixed number of worker threads working off a FIFO of jobs
+class ThreadPool
+{
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable allDone;
+    int activeJobs = 0;
+    bool stopping = false;
+
+    void work();
+
+public:
+    ThreadPool(int threadCount);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+    void submit(std::function<void()> job);
+    void wait(); //blocks until the queue is empty and no job is running
+    bool waitFor(std::chrono::milliseconds timeout); //like wait, but gives up after timeout, true if all jobs are done
+    int size() const { return workers.size(); }
+};
+
+#endif // THREADPOOL_H
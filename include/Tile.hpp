@@ -3,7 +3,8 @@
 
 #include <string>
 #include <vector>
-#include <bitset>
+#include <array>
+#include <cstdint>
 #include <memory>
 
 #include <png++/png.hpp>
@@ -12,7 +13,7 @@
 
 typedef png::image<png::rgb_pixel> Image;
 
-const int MAX_TILES = 64; // increasing this will probably have a major performance impact, since the bitset won't be a single value any more; decreasing won't do anything because even bitset<1> is 8 bytes
+const int MAX_TILES = 64 * 64; // widest Domain a Grid is instantiated for, see makeGrid; narrower tilesets still get a single word domain
 
 class Tile
 {
@@ -20,26 +21,30 @@ private:
     Image image;
     std::string name;
     std::array<TileEdge, 4> edges;
-    std::array<std::bitset<MAX_TILES>, 4> edgeMasks;
+    std::array<std::vector<uint64_t>, 4> edgeMasks; //one bit per tile, as many 64 bit words as the tileset needs
     int weight;
-    static Tile errorTile;
-    static Tile unknownTile;
+    // overrides edges with labels from a text file next to the image: top left right bottom, '-' keeps the edge of the pixels
+    void readEdgeLabels(const std::string& path);
 public:
     
     Tile(std::string path, std::string name, int weight = 1);
     Tile(Image image, std::string name, int weight = 1);
+    // an already matched tile, e.g. from a tileset cache, nothing is written to tiles/generated
+    Tile(Image image, std::string name, int weight, const std::array<TileEdge, 4>& edges, const std::array<std::vector<uint64_t>, 4>& edgeMasks);
     Tile(const Tile& other);
     Tile& operator=(const Tile& other) = delete;
     // Tile& operator=(const Tile&& other);
     
     static void matchTiles(std::vector<std::unique_ptr<Tile>>& tiles);
     void addRotations(std::vector<std::unique_ptr<Tile>>& tiles, int rotations = 3, bool mirror = false) const;
-    const std::bitset<MAX_TILES>& getEdgeMask(EdgeDirection edge) const;
+    const std::vector<uint64_t>& getEdgeMask(EdgeDirection edge) const;
     const std::string& getName() const { return name; }
     int getWeight() const { return weight; }
-    static void drawGrid(std::vector<std::vector<const Tile*>>& tiles);
-    static const Tile& getErrorTile() { return errorTile; };
-    static const Tile& getUnknownTile() { return unknownTile; };
+    const TileEdge& getEdge(EdgeDirection edge) const { return edges[edge]; }
+    const Image& getImage() const { return image; }
+    static void drawGrid(std::vector<std::vector<const Tile*>>& tiles, const std::string& path = "result.png");
+    static const Tile& getErrorTile(); //loaded on first use, most runs never draw one
+    static const Tile& getUnknownTile();
 };
 
 #endif // TILE_H
\ No newline at end of file
@@ -4,23 +4,39 @@
 #include <string>
 #include <array>
 #include <vector>
+#include <unordered_map>
 
 #include <png++/png.hpp>
 
 #include "EdgeDirection.hpp"
 
+// edges are interned, equal edges share an id and are compared by it
 class TileEdge
 {
 private:
-    const std::vector<png::rgb_pixel> pixels; //always from left to right or top to bottom
-    static std::vector<TileEdge> existingEdges;
+    static std::unordered_map<std::string, int> existingEdges; //pixel sequences and labels, tagged so they never collide
+    static std::vector<std::pair<std::string, int>> toleratedEdges; //the first pixel sequence of every edge id, what new edges are compared against
+    static int edgeCount;
+    static int colourTolerance;
     int existingEdgeIndex = -1;
+    bool labelled = false;
+    static int intern(const std::string& key);
+    static int findTolerated(const std::string& key); //id of the first edge within the tolerance on every channel or -1
 public:
-    TileEdge(const std::vector<png::rgb_pixel>& pixels);
-    static std::array<TileEdge, 4> getEdges(png::image<png::rgb_pixel> image);
+    TileEdge(const std::vector<png::rgb_pixel>& pixels); //always from left to right or top to bottom
+    explicit TileEdge(int id); //an edge known by its id only, e.g. from a tileset cache, it can't be matched against edges built from pixels
+    static TileEdge fromLabel(const std::string& label); //only matches edges with the same label, see Tile::readEdgeLabels
+    static std::array<TileEdge, 4> getEdges(const png::image<png::rgb_pixel>& image);
+    // an edge matches the first edge created before it whose channels all differ by at most tolerance, so slightly different
+    // hand painted colours still match. Two edges close to the same first edge match even if they differ by up to twice the
+    // tolerance, and which edge comes first depends on the order the tiles are loaded. Only affects edges created afterwards
+    static void setColourTolerance(int tolerance);
+    static int getColourTolerance() { return colourTolerance; }
     bool operator==(const TileEdge&) const;
+    int getId() const { return existingEdgeIndex; }
+    bool isLabel() const { return labelled; }
 };
 bool operator==(const png::rgb_pixel& a, const png::rgb_pixel& b);
 bool operator!=(const png::rgb_pixel& a, const png::rgb_pixel& b);
 
-#endif // TILEEDGE_H
\ No newline at end of file
+#endif // TILEEDGE_H
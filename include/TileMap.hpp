@@ -0,0 +1,59 @@
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#include "Tile.hpp"
+
+// a grid saved as the index of the tile of every field instead of its pixels:
+// TileMapHeader, then height * width cells row by row, one byte each for up to 254 tiles, two beyond
+// a cell holds the tile index, all bits set for an undecided field and all but the lowest for a contradiction,
+// the cells start 8 byte aligned and are in the byte order of the machine that wrote the file, so readers can map it and use it as an array
+const char TILE_MAP_MAGIC[4] = {'W', 'F', 'C', 'M'};
+const uint32_t TILE_MAP_VERSION = 1; //increment whenever the layout changes
+
+struct TileMapHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileCount; //of the tileset the map was generated with, it renders with no other
+    uint32_t cellBytes; //1 or 2
+};
+
+const int UNDECIDED_TILE = -1;
+const int CONTRADICTION_TILE = -2;
+
+typedef std::function<void(int y, std::vector<int>& row)> TileRowSource; //fills row with the tile indices of grid row y, see UNDECIDED_TILE
+
+// writes the map row by row, only one row of cells is in memory
+void writeTileMap(const std::string& path, int height, int width, uint tileCount, TileRowSource rowSource);
+
+// a map file mapped read only, the cells are read right from the mapping
+class TileMap
+{
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    const TileMapHeader* header = nullptr;
+
+public:
+    TileMap(const std::string& path);
+    TileMap(const TileMap& other) = delete;
+    TileMap& operator=(const TileMap& other) = delete;
+    ~TileMap();
+    int getWidth() const { return header->width; }
+    int getHeight() const { return header->height; }
+    uint getTileCount() const { return header->tileCount; }
+    uint getCellBytes() const { return header->cellBytes; }
+    const void* getCells() const { return data + sizeof(TileMapHeader); }
+    int getTile(int x, int y) const; //tile index, UNDECIDED_TILE or CONTRADICTION_TILE
+    // renders the fields of a rectangle of the map, e.g. to look at a part of a map far too large for a png
+    void drawViewport(const std::vector<Tile>& tiles, int left, int top, int width, int height, const std::string& path = "result.png") const;
+};
+
+#endif // TILEMAP_H
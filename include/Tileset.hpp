@@ -0,0 +1,20 @@
+#ifndef TILESET_H
+#define TILESET_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "Tile.hpp"
+
+// reads the tile images enabled in the tileset file and adds their rotations, an empty path enables all tiles
+// a tileset file holds one character per tile in the order of loadTiles, 'y' enables it
+std::vector<std::unique_ptr<Tile>> loadTiles(const std::string& tilesetPath);
+// matches the edges of all tiles and copies them into the form a Grid takes
+std::vector<Tile> matchTileset(std::vector<std::unique_ptr<Tile>>& tilesPtrs);
+std::vector<Tile> createTiles(const std::string& tilesetPath);
+// like createTiles, but maps the compiled tileset at cachePath if it was built from the same selection and tile images,
+// otherwise it is (re)compiled there, see TilesetCache
+std::vector<Tile> createTiles(const std::string& tilesetPath, const std::string& cachePath);
+
+#endif // TILESET_H
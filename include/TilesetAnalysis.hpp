@@ -0,0 +1,55 @@
+#ifndef TILESETANALYSIS_H
+#define TILESETANALYSIS_H
+
+#include <vector>
+#include <array>
+#include <ostream>
+#include <cstdint>
+#include <algorithm>
+
+#include "Tile.hpp"
+
+// where the fields of a grid lie along one axis, the fields of a class have the same neighbours before and after them
+// a grid of one row or column only has the first class, of two the first and the last, a periodic one only the middle class
+enum AxisClass
+{
+    firstOnAxis = 0,
+    middleOnAxis,
+    lastOnAxis
+};
+
+// what a grid of the given size can hold before anything is collapsed: arc consistency over the classes of fields,
+// a tile stays in the domain of a class while it fits some tile of the neighbouring classes on every side that has a neighbour.
+// Each middle class stands for many fields, so its domain only loses tiles that none of them can hold and the result is never too strict,
+// the Grid narrows the domains of the actual fields further once it propagates
+struct TilesetAnalysis
+{
+    int height = 0;
+    int width = 0;
+    bool periodic = false;
+    uint tileCount = 0;
+    std::vector<AxisClass> rowClasses; //the classes the size has
+    std::vector<AxisClass> columnClasses;
+    std::array<std::array<std::vector<uint64_t>, 3>, 3> domains; //[row class][column class]: one bit per tile, empty for classes the size doesn't have
+    std::vector<std::pair<uint, EdgeDirection>> unmatchedEdges; //(tile, side) no tile fits at all
+    std::vector<uint> unplaceable; //tiles in none of the domains
+    std::vector<uint> borderOnly; //tiles that can be placed at a border but not in the middle of the grid
+    bool satisfiable = true; //false if some field can't hold any tile, then no grid of this size can be completed
+
+    static AxisClass classOf(int i, int n, bool periodic = false)
+    { return periodic ? middleOnAxis : i == 0 ? firstOnAxis : i == n - 1 ? lastOnAxis : middleOnAxis; }
+    // sizes with the same layout along an axis (1, 2, 3, 4 or more fields, or periodic) have the same domains,
+    // 0 to AXIS_LAYOUTS - 1
+    static int axisLayout(int n, bool periodic = false)
+    { return periodic ? 0 : std::min(n, 4); }
+    static const int AXIS_LAYOUTS = 5;
+    const std::vector<uint64_t>& domainAt(int x, int y) const
+    { return domains[classOf(y, height, periodic)][classOf(x, width, periodic)]; }
+    bool prunes() const; //whether any field loses a tile
+    void print(const std::vector<Tile>& tiles, std::ostream& out) const;
+};
+
+// periodic: the grid wraps around like a Topology with periodic borders, every field has all four neighbours
+TilesetAnalysis analyseTileset(const std::vector<Tile>& tiles, int height, int width, bool periodic = false);
+
+#endif // TILESETANALYSIS_H
@@ -0,0 +1,24 @@
+#ifndef TILESETCACHE_H
+#define TILESETCACHE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "Tile.hpp"
+
+// what a compiled tileset was built from, a cache with another stamp is rebuilt
+struct TilesetStamp
+{
+    std::string selection; //'y' or 'n' for every tile source
+    int64_t newestSource = 0; //last modification of any tile image or edge label file
+    int colourTolerance = 0; //see TileEdge::setColourTolerance
+};
+
+// a compiled tileset holds everything createTiles computes: pixels, weights, edge ids and edge masks of every tile incl. rotations
+// the file is read at once and the tiles are built right from it, no png is decoded and no edge is matched
+// false if the file is missing, from another version or built from another stamp
+bool loadTilesetCache(const std::string& path, const TilesetStamp& stamp, std::vector<Tile>& tiles);
+void writeTilesetCache(const std::string& path, const TilesetStamp& stamp, const std::vector<Tile>& tiles);
+
+#endif // TILESETCACHE_H
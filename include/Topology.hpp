@@ -0,0 +1,68 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <vector>
+#include <array>
+#include <limits>
+#include <sys/types.h>
+
+#include "Position.hpp"
+
+// which field lies next to which, as a flat table: [field][direction] -> index of the neighbour, NO_NEIGHBOUR past a border
+// computed once per size, so propagation looks neighbours up instead of stepping positions and checking bounds
+// a periodic topology wraps around at the borders like a torus, every field has all four neighbours and the result tiles seamlessly
+class Topology
+{
+private:
+    int height;
+    int width;
+    bool periodic;
+    std::vector<std::array<uint, 4>> neighbours;
+
+public:
+    static constexpr uint NO_NEIGHBOUR = std::numeric_limits<uint>::max();
+
+    Topology(int height, int width, bool periodic = false);
+    void resize(int height, int width); //keeps the capacity like the other per field storage of a Grid
+    uint neighbour(uint field, EdgeDirection dir) const { return neighbours[field][dir]; }
+    const std::array<uint, 4>& neighboursOf(uint field) const { return neighbours[field]; }
+    bool isPeriodic() const { return periodic; }
+};
+
+// the two directions a VoxelTopology adds to the four EdgeDirections, towards the layer before and after
+enum VoxelDirection
+{
+    front = 4,
+    back = 5
+};
+
+const uint VOXEL_DIRECTIONS = 6;
+
+inline uint oppositeVoxel(uint dir)
+{
+    return dir < 4 ? 3 - dir : 9 - dir;
+}
+
+// the same table for a 3D grid of depth layers of height * width fields, every field has up to six neighbours:
+// the four EdgeDirections within its layer, front and back at the same place in the layers next to it.
+// Fields are numbered layer by layer, so each layer is numbered like a Topology of the same height and width.
+// The Grid still only uses Topology, its tiles have four edges
+class VoxelTopology
+{
+private:
+    int depth;
+    int height;
+    int width;
+    bool periodic;
+    std::vector<std::array<uint, VOXEL_DIRECTIONS>> neighbours;
+
+public:
+    VoxelTopology(int depth, int height, int width, bool periodic = false);
+    void resize(int depth, int height, int width);
+    uint neighbour(uint field, uint dir) const { return neighbours[field][dir]; }
+    const std::array<uint, VOXEL_DIRECTIONS>& neighboursOf(uint field) const { return neighbours[field]; }
+    uint getIndex(int x, int y, int z) const { return (z * height + y) * width + x; }
+    bool isPeriodic() const { return periodic; }
+};
+
+#endif // TOPOLOGY_H
@@ -0,0 +1,78 @@
+#include "ChunkedGenerator.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+ChunkedGenerator::ChunkedGenerator(const std::vector<Tile>& tiles, int height, int width, int chunkSize, const GridSettings& settings, int attempts):
+    tiles(tiles),
+    height(height),
+    width(width),
+    chunkSize(chunkSize),
+    settings(settings),
+    attempts(std::max(attempts, 1)),
+    bottomRow(width, -1),
+    rightColumn(chunkSize, -1)
+{
+}
+
+GridBase& ChunkedGenerator::generateChunk(int chunkX, int chunkY, int chunkHeight, int chunkWidth, uint64_t seed, bool& success)
+{
+    for (int attempt = 0; attempt < attempts; attempt++)
+    {
+        settings.seed = seed + attempt;
+        if (grid)
+        {
+            grid->resize(chunkHeight, chunkWidth, *settings.seed);
+        }
+        else
+        {
+            grid = makeGrid(tiles, chunkHeight, chunkWidth, settings);
+        }
+        for (int x = 0; x < chunkWidth; x++)
+        {
+            int above = bottomRow[chunkX * chunkSize + x];
+            if (above != -1)
+            { grid->requireNeighbour(x, 0, top, above); }
+        }
+        for (int y = 0; y < chunkHeight; y++)
+        {
+            if (chunkX > 0 && rightColumn[y] != -1)
+            { grid->requireNeighbour(0, y, left, rightColumn[y]); }
+        }
+        success = grid->run();
+        if (success)
+        { break; }
+        *settings.log << "chunk " << chunkX << "|" << chunkY << " failed with seed " << *settings.seed << "\n";
+    }
+    return *grid;
+}
+
+int ChunkedGenerator::run(const std::string& pathPrefix, uint64_t seed)
+{
+    int chunksX = (width + chunkSize - 1) / chunkSize;
+    int chunksY = (height + chunkSize - 1) / chunkSize;
+    int failedChunks = 0;
+    for (int chunkY = 0; chunkY < chunksY; chunkY++)
+    {
+        int chunkHeight = std::min(chunkSize, height - chunkY * chunkSize);
+        for (int chunkX = 0; chunkX < chunksX; chunkX++)
+        {
+            int chunkWidth = std::min(chunkSize, width - chunkX * chunkSize);
+            bool success = false;
+            uint64_t chunkSeed = seed + (uint64_t) (chunkY * chunksX + chunkX) * attempts;
+            GridBase& grid = generateChunk(chunkX, chunkY, chunkHeight, chunkWidth, chunkSeed, success);
+            failedChunks += !success;
+            grid.drawGrid(pathPrefix + "_" + std::to_string(chunkY) + "_" + std::to_string(chunkX) + ".png");
+
+            for (int y = 0; y < chunkHeight; y++)
+            {
+                rightColumn[y] = grid.getTile(chunkWidth - 1, y);
+            }
+            for (int x = 0; x < chunkWidth; x++)
+            {
+                bottomRow[chunkX * chunkSize + x] = grid.getTile(x, chunkHeight - 1);
+            }
+        }
+    }
+    return failedChunks;
+}
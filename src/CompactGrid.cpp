@@ -0,0 +1,528 @@
+#include "CompactGrid.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "Error.hpp"
+#include "GridImageWriter.hpp"
+#include "TileMap.hpp"
+
+template<uint Words>
+CompactGrid<Words>::CompactGrid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings):
+    tiles(tiles),
+    height(height),
+    width(width),
+    allTiles(Field::firstN(tiles.size())),
+    cancel(settings.cancel),
+    progress(settings.progress),
+    log(*settings.log),
+    timePhases(settings.timePhases),
+    randGen(settings.seed ? *settings.seed : std::chrono::high_resolution_clock::now().time_since_epoch().count())
+{
+    validateSettings(settings, tiles.size());
+    initialWeights = {0, 0};
+    for (const Tile& tile : tiles)
+    {
+        edgeMasks.push_back({Field::fromWords(tile.getEdgeMask(top)), Field::fromWords(tile.getEdgeMask(left)),
+            Field::fromWords(tile.getEdgeMask(right)), Field::fromWords(tile.getEdgeMask(bottom))});
+        tileWeights.push_back(tile.getWeight());
+        tileWeightLogWeights.push_back(tile.getWeight() * std::log((double) tile.getWeight()));
+        initialWeights.weight += tile.getWeight();
+        initialWeights.weightLogWeight += tileWeightLogWeights.back();
+    }
+    logSums.push_back(0);
+    for (uint sum = 1; sum <= initialWeights.weight; sum++)
+    {
+        logSums.push_back(std::log((float) sum));
+    }
+    initialEntropy = calculateEntropy(initialWeights);
+    cells.resize(height * width, UNTOUCHED);
+}
+
+template<uint Words>
+void CompactGrid<Words>::reset(uint64_t seed)
+{
+    randGen.seed(seed);
+    std::fill(cells.begin(), cells.end(), UNTOUCHED);
+    frontier.clear();
+    freeSlots.clear();
+    frontierSlots.clear();
+    heap.clear();
+    untouchedCursor = 0;
+    queue.clear();
+    queueHead = 0;
+    constrainedFields.clear();
+    constraintContradiction = false;
+    stats = RunStats();
+}
+
+template<uint Words>
+void CompactGrid<Words>::resize(int newHeight, int newWidth, uint64_t seed)
+{
+    height = newHeight;
+    width = newWidth;
+    cells.resize(height * width);
+    reset(seed);
+}
+
+template<uint Words>
+typename CompactGrid<Words>::FrontierField& CompactGrid<Words>::touch(uint field)
+{
+    if (cells[field] == FRONTIER)
+    {
+        return frontier[frontierSlots.find(field)->second];
+    }
+    uint slot;
+    if (freeSlots.empty())
+    {
+        slot = frontier.size();
+        frontier.emplace_back();
+    }
+    else
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+    frontierSlots.emplace(field, slot);
+    cells[field] = FRONTIER;
+    FrontierField& state = frontier[slot];
+    state.domain = allTiles;
+    state.combinedEdgeMasks = {allTiles, allTiles, allTiles, allTiles}; //what the cache of a Grid starts with
+    state.sums = initialWeights;
+    state.field = field;
+    state.queued = false;
+    heap.push_back({initialEntropy, field, slot});
+    state.heapSlot = heap.size() - 1;
+    siftUp(state.heapSlot);
+    return state;
+}
+
+template<uint Words>
+void CompactGrid<Words>::settle(uint field, Cell cell)
+{
+    if (cells[field] == FRONTIER)
+    {
+        auto it = frontierSlots.find(field);
+        uint slot = it->second;
+        frontierSlots.erase(it);
+        uint heapSlot = frontier[slot].heapSlot;
+        HeapEntry last = heap.back();
+        heap.pop_back();
+        if (heapSlot < heap.size())
+        {
+            place(heapSlot, last);
+            siftUp(heapSlot);
+            siftDown(frontier[last.frontierSlot].heapSlot);
+        }
+        freeSlots.push_back(slot);
+    }
+    cells[field] = cell;
+}
+
+template<uint Words>
+void CompactGrid<Words>::removeWeights(FrontierField& state, const Field& removed)
+{
+    removed.forEach([&](uint iTile) {
+        state.sums.weight -= tileWeights[iTile];
+        state.sums.weightLogWeight -= tileWeightLogWeights[iTile];
+    });
+}
+
+template<uint Words>
+inline void CompactGrid<Words>::place(uint heapSlot, const HeapEntry& entry)
+{
+    heap[heapSlot] = entry;
+    frontier[entry.frontierSlot].heapSlot = heapSlot;
+}
+
+template<uint Words>
+void CompactGrid<Words>::siftUp(uint heapSlot)
+{
+    HeapEntry entry = heap[heapSlot];
+    while (heapSlot > 0)
+    {
+        uint parent = (heapSlot - 1) / 2;
+        if (!(entry < heap[parent]))
+        { break; }
+        place(heapSlot, heap[parent]);
+        heapSlot = parent;
+    }
+    place(heapSlot, entry);
+}
+
+template<uint Words>
+void CompactGrid<Words>::siftDown(uint heapSlot)
+{
+    HeapEntry entry = heap[heapSlot];
+    uint size = heap.size();
+    while (true)
+    {
+        uint child = 2 * heapSlot + 1;
+        if (child >= size)
+        { break; }
+        if (child + 1 < size && heap[child + 1] < heap[child])
+        { child++; }
+        if (!(heap[child] < entry))
+        { break; }
+        place(heapSlot, heap[child]);
+        heapSlot = child;
+    }
+    place(heapSlot, entry);
+}
+
+template<uint Words>
+void CompactGrid<Words>::updateEntropy(FrontierField& state)
+{
+    COUNT(stats.counters.entropyRecomputes++);
+    heap[state.heapSlot].entropy = calculateEntropy(state.sums);
+    siftUp(state.heapSlot);
+    siftDown(state.heapSlot);
+}
+
+template<uint Words>
+typename CompactGrid<Words>::Field CompactGrid<Words>::combinedEdgeMask(const Position& pos, EdgeDirection edge)
+{
+    if (!isValid(pos))
+    {
+        return allTiles;
+    }
+    uint field = getIndex(pos);
+    Cell cell = cells[field];
+    if (cell == UNTOUCHED)
+    {
+        return allTiles;
+    }
+    if (cell == CONTRADICTION)
+    {
+        return Field();
+    }
+    if (cell != FRONTIER)
+    {
+        return edgeMasks[cell][edge];
+    }
+    FrontierField& state = frontier[frontierSlots.find(field)->second];
+    Field& mask = state.combinedEdgeMasks[edge];
+    if (mask.any())
+    {
+        COUNT(stats.counters.maskCacheHits++);
+        return mask;
+    }
+    COUNT(stats.counters.maskRecomputes++);
+    state.domain.forEach([&](uint iTile) {
+        mask |= edgeMasks[iTile][edge];
+    });
+    return mask;
+}
+
+template<uint Words>
+void CompactGrid<Words>::push(uint field)
+{
+    Cell cell = cells[field];
+    if (cell != UNTOUCHED && cell != FRONTIER)
+    { return; } //decided fields never change again
+    FrontierField& state = touch(field);
+    if (state.queued)
+    { return; }
+    state.queued = true;
+    queue.push_back(field);
+}
+
+template<uint Words>
+void CompactGrid<Words>::insertNeighbours(const Position& pos)
+{
+    //same order as Grid, so both apply the same removals in the same order
+    for (EdgeDirection dir : {top, right, left, bottom})
+    {
+        if (isValid(pos.get(dir)))
+        {
+            push(getIndex(pos.get(dir)));
+        }
+    }
+}
+
+template<uint Words>
+bool CompactGrid<Words>::fitsNeighbours(uint field)
+{
+    Position pos = getPosition(field);
+    Field mask = combinedEdgeMask(pos.get(top), bottom) & combinedEdgeMask(pos.get(right), left)
+        & combinedEdgeMask(pos.get(left), right) & combinedEdgeMask(pos.get(bottom), top);
+    Cell cell = cells[field];
+    if (cell == FRONTIER)
+    {
+        return (frontier[frontierSlots.find(field)->second].domain & mask).any();
+    }
+    return cell < CONTRADICTION && mask.test(cell);
+}
+
+template<uint Words>
+bool CompactGrid<Words>::updateField(uint field)
+{
+    Position pos = getPosition(field);
+    Field mask = combinedEdgeMask(pos.get(top), bottom) & combinedEdgeMask(pos.get(right), left)
+        & combinedEdgeMask(pos.get(left), right) & combinedEdgeMask(pos.get(bottom), top);
+    FrontierField& state = frontier[frontierSlots.find(field)->second];
+    Field updated = state.domain & mask;
+    if (updated == state.domain)
+    { return false; }
+    removeWeights(state, state.domain.without(updated));
+    state.domain = updated;
+    state.combinedEdgeMasks = {};
+    if (updated.none())
+    {
+        log << "Contradiction in Field " << pos.x << "|" << pos.y << " (" << field << ")\n";
+        settle(field, CONTRADICTION);
+        throw errors[Error::Code::contradiction];
+    }
+    if (updated.count() == 1)
+    {
+        COUNT(stats.counters.propagatedSingletons++);
+        settle(field, updated.first());
+    }
+    else
+    {
+        updateEntropy(state);
+    }
+    return true;
+}
+
+template<uint Words>
+void CompactGrid<Words>::propagateQueued()
+{
+    while (queueHead < queue.size())
+    {
+        uint field = queue[queueHead++];
+        if (cells[field] != FRONTIER)
+        { continue; }
+        frontier[frontierSlots.find(field)->second].queued = false;
+        COUNT(stats.counters.updateCalls++);
+        if (updateField(field))
+        {
+            COUNT(stats.counters.updateChanges++);
+            insertNeighbours(getPosition(field));
+        }
+    }
+    queue.clear();
+    queueHead = 0;
+}
+
+template<uint Words>
+int CompactGrid<Words>::collapseOne()
+{
+    while (untouchedCursor < cells.size() && cells[untouchedCursor] != UNTOUCHED)
+    { untouchedCursor++; }
+    bool untouchedLeft = untouchedCursor < cells.size();
+    if (heap.empty() && !untouchedLeft)
+    { return -1; }
+    //the lowest entropy of all untouched fields is the one of the first of them
+    bool fromFrontier = !heap.empty() && (!untouchedLeft || heap.front() < HeapEntry{initialEntropy, untouchedCursor, 0});
+    uint iField = fromFrontier ? heap.front().field : untouchedCursor;
+    const Field& domain = fromFrontier ? frontier[heap.front().frontierSlot].domain : allTiles;
+    uint weight = fromFrontier ? frontier[heap.front().frontierSlot].sums.weight : initialWeights.weight;
+    //the same pick as Grid::collapseField
+    uint rnd = std::uniform_int_distribution<uint>(0, weight - 1)(randGen);
+    uint iTile = domain.findIf([&](uint i) {
+        if (rnd < tileWeights[i])
+        { return true; }
+        rnd -= tileWeights[i];
+        return false;
+    });
+    settle(iField, iTile);
+    COUNT(stats.counters.decisions++);
+    return iField;
+}
+
+template<uint Words>
+inline void CompactGrid<Words>::lap(std::chrono::nanoseconds& phase)
+{
+    if (!timePhases)
+    { return; }
+    auto now = std::chrono::steady_clock::now();
+    phase += now - lastLap;
+    lastLap = now;
+}
+
+template<uint Words>
+bool CompactGrid<Words>::run()
+{
+    runStart = std::chrono::steady_clock::now();
+    bool success = solve();
+    if (progress != nullptr)
+    {
+        publishProgress(true, success);
+    }
+    return success;
+}
+
+template<uint Words>
+bool CompactGrid<Words>::solve()
+{
+    lastLap = runStart;
+    try
+    {
+        if (constraintContradiction)
+        {
+            log << "The fields required by the surrounding tiles contradict each other\n";
+            throw errors[Error::Code::contradiction];
+        }
+        for (uint iField : constrainedFields)
+        {
+            //push skips decided fields, two of them decided by the constraints side by side only meet here
+            if (!fitsNeighbours(iField))
+            {
+                constraintContradiction = true;
+                log << "The fields required by the surrounding tiles contradict each other\n";
+                throw errors[Error::Code::contradiction];
+            }
+            insertNeighbours(getPosition(iField));
+        }
+        constrainedFields.clear();
+        propagateQueued();
+        lap(stats.propagation);
+        int collapsed = collapseOne();
+        lap(stats.collapse);
+        while (collapsed != -1)
+        {
+            if (cancel != nullptr && cancel->load(std::memory_order_relaxed))
+            { return false; }
+            insertNeighbours(getPosition(collapsed));
+            propagateQueued();
+            lap(stats.propagation);
+            if (progress != nullptr && progress->due())
+            {
+                publishProgress(false, false);
+            }
+            collapsed = collapseOne();
+            lap(stats.collapse);
+        }
+    }
+    catch (Error err)
+    {
+        if (err.code == Error::Code::contradiction)
+        {
+            log << err.message << "\n";
+            return false;
+        }
+        else throw err;
+    }
+    return true;
+}
+
+template<uint Words>
+void CompactGrid<Words>::publishProgress(bool finished, bool success)
+{
+    ProgressSnapshot& snapshot = progress->fill(height, width, tiles.size(), [&](uint iField) {
+        Cell cell = cells[iField];
+        return cell < CONTRADICTION ? (int) cell : cell == CONTRADICTION ? CONTRADICTION_TILE : UNDECIDED_TILE;
+    });
+    snapshot.backtracks = 0;
+    snapshot.elapsed = std::chrono::steady_clock::now() - runStart;
+    snapshot.finished = finished;
+    snapshot.success = success;
+    progress->publish();
+}
+
+template<uint Words>
+void CompactGrid<Words>::requireNeighbour(int x, int y, EdgeDirection side, uint tile)
+{
+    restrictField(getIndex({x, y}), edgeMasks[tile][opposite(side)]);
+}
+
+template<uint Words>
+void CompactGrid<Words>::applyConstraints(const Constraints& constraints)
+{
+    forEachConstraint(constraints, height, width, tiles.size(), [&](uint iField, const std::vector<uint64_t>& allowed) {
+        restrictField(iField, Field::fromWords(allowed) & allTiles);
+    });
+}
+
+template<uint Words>
+void CompactGrid<Words>::restrictField(uint iField, const Field& allowed)
+{
+    Cell cell = cells[iField];
+    if (cell == CONTRADICTION)
+    { return; }
+    if (cell != UNTOUCHED && cell != FRONTIER)
+    {
+        if (!allowed.test(cell))
+        {
+            cells[iField] = CONTRADICTION;
+            constraintContradiction = true;
+        }
+        return;
+    }
+    FrontierField& state = touch(iField);
+    Field removed = state.domain.without(allowed);
+    if (removed.none())
+    { return; }
+    removeWeights(state, removed);
+    state.domain &= allowed;
+    state.combinedEdgeMasks = {};
+    if (state.domain.none())
+    {
+        settle(iField, CONTRADICTION);
+        constraintContradiction = true;
+        return;
+    }
+    if (state.domain.count() == 1)
+    {
+        settle(iField, state.domain.first());
+    }
+    else
+    {
+        updateEntropy(state);
+    }
+    constrainedFields.push_back(iField);
+}
+
+template<uint Words>
+int CompactGrid<Words>::getTile(int x, int y) const
+{
+    Cell cell = cells[getIndex({x, y})];
+    return cell < CONTRADICTION ? (int) cell : -1;
+}
+
+template<uint Words>
+void CompactGrid<Words>::drawGrid(const std::string& path)
+{
+    const Image& first = tiles[0].getImage();
+    GridImageWriter writer(height, width, first.get_height(), first.get_width(), [&](int y, std::vector<const Tile*>& row) {
+        for (int x = 0; x < width; x++)
+        {
+            Cell cell = cells[getIndex({x, y})];
+            if (cell == UNTOUCHED || cell == FRONTIER)
+            {
+                row[x] = &Tile::getUnknownTile();
+            }
+            else if (cell == CONTRADICTION)
+            {
+                row[x] = &Tile::getErrorTile();
+            }
+            else
+            {
+                row[x] = &tiles[cell];
+            }
+        }
+    });
+    writer.write(path);
+}
+
+template<uint Words>
+void CompactGrid<Words>::writeTileMap(const std::string& path)
+{
+    ::writeTileMap(path, height, width, tiles.size(), [&](int y, std::vector<int>& row) {
+        for (int x = 0; x < width; x++)
+        {
+            Cell cell = cells[getIndex({x, y})];
+            row[x] = cell < CONTRADICTION ? (int) cell : cell == CONTRADICTION ? CONTRADICTION_TILE : UNDECIDED_TILE;
+        }
+    });
+}
+
+template class CompactGrid<1>;
+template class CompactGrid<2>;
+template class CompactGrid<4>;
+template class CompactGrid<8>;
+template class CompactGrid<16>;
+template class CompactGrid<32>;
+template class CompactGrid<64>;
@@ -0,0 +1,162 @@
+#include "Constraints.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "Options.hpp"
+
+static std::vector<uint64_t> maskOf(const std::vector<uint>& tiles)
+{
+    std::vector<uint64_t> mask;
+    for (uint tile : tiles)
+    {
+        if (tile / 64 >= mask.size())
+        {
+            mask.resize(tile / 64 + 1, 0);
+        }
+        mask[tile / 64] |= uint64_t(1) << (tile % 64);
+    }
+    return mask;
+}
+
+void Constraints::allowInRegion(int x, int y, int width, int height, const std::vector<uint>& tiles)
+{
+    regions.push_back({x, y, width, height, maskOf(tiles)});
+}
+
+void Constraints::allowAtBorder(EdgeDirection side, const std::vector<uint>& tiles)
+{
+    borders[side] = maskOf(tiles);
+}
+
+bool Constraints::empty() const
+{
+    return fixed.empty() && regions.empty() && borders[top].empty() && borders[left].empty() && borders[right].empty()
+        && borders[bottom].empty();
+}
+
+void forEachConstraint(const Constraints& constraints, int height, int width, uint tileCount,
+    const std::function<void(uint field, const std::vector<uint64_t>& allowed)>& apply)
+{
+    auto checkMask = [&](const std::vector<uint64_t>& mask) {
+        for (uint i = tileCount / 64; i < mask.size(); i++)
+        {
+            if (mask[i] >> (i == tileCount / 64 ? tileCount % 64 : 0) != 0)
+            {
+                throw std::string("A constraint allows tiles beyond the ") + std::to_string(tileCount) + " of the tileset";
+            }
+        }
+    };
+    for (uint side = 0; side < 4; side++)
+    {
+        const std::vector<uint64_t>& allowed = constraints.borders[side];
+        if (allowed.empty())
+        { continue; }
+        checkMask(allowed);
+        bool horizontal = side == top || side == bottom;
+        int fixedCoordinate = side == top || side == left ? 0 : horizontal ? height - 1 : width - 1;
+        for (int i = 0; i < (horizontal ? width : height); i++)
+        {
+            apply(horizontal ? fixedCoordinate * width + i : i * width + fixedCoordinate, allowed);
+        }
+    }
+    for (const Constraints::Region& region : constraints.regions)
+    {
+        if (region.x < 0 || region.y < 0 || region.width < 0 || region.height < 0
+            || region.x + region.width > width || region.y + region.height > height)
+        {
+            throw std::string("The constrained region at ") + std::to_string(region.x) + "|" + std::to_string(region.y)
+                + " exceeds the " + std::to_string(width) + "x" + std::to_string(height) + " grid";
+        }
+        checkMask(region.allowed);
+        for (int y = region.y; y < region.y + region.height; y++)
+        {
+            for (int x = region.x; x < region.x + region.width; x++)
+            {
+                apply(y * width + x, region.allowed);
+            }
+        }
+    }
+    std::vector<uint64_t> single((tileCount + 63) / 64, 0);
+    for (auto [pos, tile] : constraints.fixed)
+    {
+        if (pos.x < 0 || pos.y < 0 || pos.x >= width || pos.y >= height || tile >= tileCount)
+        {
+            throw std::string("Can't fix tile ") + std::to_string(tile) + " at " + std::to_string(pos.x) + "|" + std::to_string(pos.y);
+        }
+        single[tile / 64] = uint64_t(1) << (tile % 64);
+        apply(pos.y * width + pos.x, single);
+        single[tile / 64] = 0;
+    }
+}
+
+static uint findTile(const std::string& nameOrIndex, const std::vector<Tile>& tiles)
+{
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+    {
+        if (tiles[iTile].getName() == nameOrIndex)
+        { return iTile; }
+    }
+    if (!nameOrIndex.empty() && nameOrIndex.find_first_not_of("0123456789") == std::string::npos
+        && std::stoul(nameOrIndex) < tiles.size())
+    {
+        return std::stoul(nameOrIndex);
+    }
+    throw std::string("Unknown tile \"") + nameOrIndex + "\"";
+}
+
+static std::vector<uint> findTiles(const std::string& list, const std::vector<Tile>& tiles)
+{
+    std::vector<uint> indices;
+    for (const std::string& item : splitList(list))
+    {
+        indices.push_back(findTile(item, tiles));
+    }
+    return indices;
+}
+
+Constraints readConstraints(const std::string& path, const std::vector<Tile>& tiles)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::string("Could not read the constraints ") + path;
+    }
+    Constraints constraints;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::string kind;
+        if (!(words >> kind))
+        { continue; }
+        int x, y, width, height;
+        std::string tileList;
+        if (kind == "fix" && words >> x >> y >> tileList)
+        {
+            constraints.fix(x, y, findTile(tileList, tiles));
+        }
+        else if (kind == "region" && words >> x >> y >> width >> height >> tileList)
+        {
+            constraints.allowInRegion(x, y, width, height, findTiles(tileList, tiles));
+        }
+        else if (kind == "border" && words >> kind >> tileList)
+        {
+            const std::array<std::string, 4> sides = {"top", "left", "right", "bottom"};
+            auto side = std::find(sides.begin(), sides.end(), kind);
+            if (side == sides.end())
+            {
+                throw path + ":" + std::to_string(lineNumber) + ": unknown border \"" + kind + "\"";
+            }
+            constraints.allowAtBorder(static_cast<EdgeDirection>(side - sides.begin()), findTiles(tileList, tiles));
+        }
+        else
+        {
+            throw path + ":" + std::to_string(lineNumber) + ": expected fix X Y TILE, region X Y WIDTH HEIGHT TILES or border SIDE TILES";
+        }
+    }
+    return constraints;
+}
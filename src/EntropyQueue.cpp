@@ -0,0 +1,103 @@
+#include "EntropyQueue.hpp"
+
+EntropyQueue::EntropyQueue(uint fieldCount, uint firstField):
+    positions(fieldCount, -1),
+    firstField(firstField)
+{
+    heap.reserve(fieldCount);
+}
+
+void EntropyQueue::resize(uint fieldCount)
+{
+    heap.clear();
+    heap.reserve(fieldCount);
+    positions.assign(fieldCount, -1);
+}
+
+void EntropyQueue::fill(float entropy)
+{
+    //equal entropies ordered by field index already satisfy the heap property
+    heap.clear();
+    for (uint i = 0; i < positions.size(); i++)
+    {
+        heap.push_back({entropy, firstField + i});
+        positions[i] = i;
+    }
+}
+
+inline bool EntropyQueue::less(uint a, uint b) const
+{
+    return heap[a] < heap[b];
+}
+
+inline void EntropyQueue::place(uint slot, const std::pair<float, uint>& entry)
+{
+    heap[slot] = entry;
+    positions[entry.second - firstField] = slot;
+}
+
+void EntropyQueue::siftUp(uint slot)
+{
+    std::pair<float, uint> entry = heap[slot];
+    while (slot > 0)
+    {
+        uint parent = (slot - 1) / 2;
+        if (!(entry < heap[parent]))
+        { break; }
+        place(slot, heap[parent]);
+        slot = parent;
+    }
+    place(slot, entry);
+}
+
+void EntropyQueue::siftDown(uint slot)
+{
+    std::pair<float, uint> entry = heap[slot];
+    uint size = heap.size();
+    while (true)
+    {
+        uint child = 2 * slot + 1;
+        if (child >= size)
+        { break; }
+        if (child + 1 < size && less(child + 1, child))
+        { child++; }
+        if (!(heap[child] < entry))
+        { break; }
+        place(slot, heap[child]);
+        slot = child;
+    }
+    place(slot, entry);
+}
+
+void EntropyQueue::update(uint field, float entropy)
+{
+    int slot = positions[field - firstField];
+    if (slot == -1)
+    {
+        heap.push_back({entropy, field});
+        positions[field - firstField] = heap.size() - 1;
+        siftUp(heap.size() - 1);
+        return;
+    }
+    float old = heap[slot].first;
+    heap[slot].first = entropy;
+    if (entropy < old)
+    { siftUp(slot); }
+    else
+    { siftDown(slot); }
+}
+
+void EntropyQueue::remove(uint field)
+{
+    int slot = positions[field - firstField];
+    if (slot == -1)
+    { return; }
+    positions[field - firstField] = -1;
+    std::pair<float, uint> last = heap.back();
+    heap.pop_back();
+    if ((uint) slot == heap.size())
+    { return; }
+    place(slot, last);
+    siftUp(slot);
+    siftDown(positions[last.second - firstField]);
+}
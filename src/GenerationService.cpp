@@ -0,0 +1,364 @@
+#include "GenerationService.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Tileset.hpp"
+#include "Options.hpp"
+#include "Error.hpp"
+
+using namespace std::chrono;
+
+// one client: requests are read line by line by a single thread, responses are written by the pool's threads
+struct GenerationService::Connection
+{
+    const int inFd;
+    const int outFd;
+    const bool ownsFds; //closed once the last response is written, the connection lives as long as a job refers to it
+    std::mutex writeMutex;
+    std::string buffer; //read but not split into lines yet
+
+    Connection(int inFd, int outFd, bool ownsFds): inFd(inFd), outFd(outFd), ownsFds(ownsFds) {}
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    ~Connection()
+    {
+        if (ownsFds)
+        {
+            close(inFd);
+            if (outFd != inFd)
+            { close(outFd); }
+        }
+    }
+
+    bool readLine(std::string& line)
+    {
+        while (true)
+        {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos)
+            {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            char chunk[4096];
+            ssize_t bytes = read(inFd, chunk, sizeof(chunk));
+            if (bytes < 0 && errno == EINTR)
+            { continue; }
+            if (bytes <= 0)
+            {
+                //a last request without a line break still counts
+                line.swap(buffer);
+                buffer.clear();
+                return !line.empty();
+            }
+            buffer.append(chunk, bytes);
+        }
+    }
+
+    // a whole response at once, so responses of concurrent jobs never interleave; a client that went away is ignored
+    void send(const std::string& text)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        size_t written = 0;
+        while (written < text.size())
+        {
+            ssize_t bytes = write(outFd, text.data() + written, text.size() - written);
+            if (bytes < 0 && errno == EINTR)
+            { continue; }
+            if (bytes <= 0)
+            { return; }
+            written += bytes;
+        }
+    }
+};
+
+// discards what the grids of the requests log
+class NullBuffer : public std::streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+};
+
+static NullBuffer nullBuffer;
+
+// clients name files relative to the directories of the service, they must not reach out of them
+static bool staysInside(const std::string& path)
+{
+    std::filesystem::path relative(path);
+    if (relative.empty() || relative.is_absolute())
+    { return false; }
+    for (const std::filesystem::path& part : relative)
+    {
+        if (part == "..")
+        { return false; }
+    }
+    return true;
+}
+
+static GridSettings withLog(GridSettings settings, std::ostream* log)
+{
+    settings.log = log;
+    return settings;
+}
+
+GenerationService::GenerationService(const GridSettings& settings, int threadCount, const std::string& tileCache, const std::string& outputDir):
+    tileCache(tileCache),
+    outputDir(outputDir),
+    quietLog(&nullBuffer),
+    settings(withLog(settings, &quietLog)),
+    pool(threadCount)
+{
+}
+
+const std::vector<Tile>& GenerationService::getTileset(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(tilesetsMutex);
+    auto it = tilesets.find(path);
+    if (it != tilesets.end())
+    {
+        return *it->second;
+    }
+    if (!path.empty() && !std::filesystem::exists(path))
+    {
+        throw std::string("Tileset ") + path + " does not exist";
+    }
+    std::unique_ptr<std::vector<Tile>> tiles;
+    if (tileCache.empty())
+    {
+        tiles = std::make_unique<std::vector<Tile>>(createTiles(path));
+    }
+    else
+    {
+        std::string name = path.empty() ? "all" : path;
+        std::replace(name.begin(), name.end(), '/', '_');
+        tiles = std::make_unique<std::vector<Tile>>(createTiles(path, tileCache + "_" + name));
+    }
+    if (tiles->empty())
+    {
+        throw std::string("Tileset ") + path + " selects no tiles";
+    }
+    return *(tilesets[path] = std::move(tiles));
+}
+
+bool GenerationService::isLoaded(const std::string& tilesetPath)
+{
+    std::lock_guard<std::mutex> lock(tilesetsMutex);
+    return tilesets.count(tilesetPath) > 0;
+}
+
+void GenerationService::preload(const std::string& tilesetPath)
+{
+    getTileset(tilesetPath);
+}
+
+void GenerationService::handle(const std::shared_ptr<Connection>& connection, const std::string& line, uint64_t number)
+{
+    std::map<std::string, std::string> request;
+    for (const std::string& token : splitList(line, ' '))
+    {
+        size_t split = token.find('=');
+        if (split != std::string::npos)
+        {
+            request[token.substr(0, split)] = token.substr(split + 1);
+        }
+        else if (!token.empty())
+        {
+            request[token] = "";
+        }
+    }
+    std::string id = request.count("id") ? request["id"] : std::to_string(number);
+
+    int width, height, attempts;
+    uint64_t seed;
+    std::string format;
+    std::string out;
+    const std::vector<Tile>* tiles;
+    try
+    {
+        width = request.count("width") ? std::stoi(request["width"]) : 30;
+        height = request.count("height") ? std::stoi(request["height"]) : 30;
+        attempts = request.count("attempts") ? std::stoi(request["attempts"]) : 1;
+        seed = request.count("seed") ? parseSeed(request["seed"]) : high_resolution_clock::now().time_since_epoch().count();
+        if (width < 1 || height < 1 || attempts < 1)
+        {
+            throw std::string("width, height and attempts have to be positive");
+        }
+        format = request.count("format") ? request["format"] : "png";
+        if (format != "png" && format != "tiles" && format != "map")
+        {
+            throw std::string("Unknown format \"") + format + "\", expected png, tiles or map";
+        }
+        out = request.count("out") ? request["out"] : "result_" + id + (format == "map" ? ".wfcmap" : ".png");
+        if (!staysInside(out))
+        {
+            throw std::string("out has to be a relative path without \"..\"");
+        }
+        if (!outputDir.empty())
+        {
+            out = (std::filesystem::path(outputDir) / out).string();
+        }
+        std::string tileset = request.count("tileset") && request["tileset"] != "all" ? request["tileset"] : "";
+        //the preloaded tilesets were chosen by whoever started the service
+        if (!tileset.empty() && !isLoaded(tileset) && !staysInside(tileset))
+        {
+            throw std::string("tileset has to be preloaded or a relative path without \"..\"");
+        }
+        tiles = &getTileset(tileset);
+    }
+    catch (std::string s)
+    {
+        connection->send(id + " error " + s + "\n");
+        return;
+    }
+    catch (std::logic_error&)
+    {
+        connection->send(id + " error malformed number in \"" + line + "\"\n");
+        return;
+    }
+
+    pool.submit([this, connection, id, width, height, attempts, seed, format, out, tiles]() {
+        auto start = high_resolution_clock::now();
+        GridSettings attemptSettings = settings;
+        std::string response;
+        try
+        {
+            std::unique_ptr<GridBase> grid;
+            bool success = false;
+            attemptSettings.seed = seed;
+            grid = makeGrid(*tiles, height, width, attemptSettings);
+            success = grid->run();
+            for (int i = 1; i < attempts && !success; i++)
+            {
+                attemptSettings.seed = seed + i;
+                grid->reset(*attemptSettings.seed);
+                success = grid->run();
+            }
+            std::string result = " seed=" + std::to_string(*attemptSettings.seed);
+            if (success && format == "png")
+            {
+                grid->drawGrid(out);
+                result += " out=" + out;
+            }
+            else if (success && format == "map")
+            {
+                grid->writeTileMap(out);
+                result += " out=" + out;
+            }
+            else if (success)
+            {
+                result += " tiles=";
+                for (int y = 0; y < height; y++)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        if (x > 0)
+                        { result += ","; }
+                        result += std::to_string(grid->getTile(x, y));
+                    }
+                    if (y + 1 < height)
+                    { result += ";"; }
+                }
+            }
+            auto ms = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+            response = id + (success ? " ok" : " contradiction") + " ms=" + std::to_string(ms) + result + "\n";
+        }
+        catch (Error err)
+        {
+            response = id + " error " + err.message + "\n";
+        }
+        catch (std::string s)
+        {
+            response = id + " error " + s + "\n";
+        }
+        catch (...)
+        {
+            response = id + " error unexpected\n";
+        }
+        connection->send(response);
+    });
+}
+
+void GenerationService::serveConnection(const std::shared_ptr<Connection>& connection)
+{
+    std::string line;
+    uint64_t number = 0;
+    while (connection->readLine(line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        { continue; }
+        if (line.back() == '\r')
+        { line.pop_back(); }
+        handle(connection, line, ++number);
+    }
+}
+
+void GenerationService::serve(int inFd, int outFd)
+{
+    serveConnection(std::make_shared<Connection>(inFd, outFd, false));
+    pool.wait();
+}
+
+void GenerationService::listen(const std::string& socketPath)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        throw std::string("Socket path ") + socketPath + " is too long";
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))
+        {
+            throw std::string("Won't listen on ") + socketPath + ", it exists and is no socket";
+        }
+        //a socket nobody accepts on any more is left by a service that ended, a live one is not taken over
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe != -1 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        int probeError = errno;
+        if (probe != -1)
+        { close(probe); }
+        if (live)
+        {
+            throw std::string("Won't listen on ") + socketPath + ", it is already served by another process";
+        }
+        if (probeError != ECONNREFUSED)
+        {
+            throw std::string("Won't listen on ") + socketPath + ": " + std::strerror(probeError);
+        }
+        unlink(socketPath.c_str());
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 64) != 0)
+    {
+        throw std::string("Could not listen on ") + socketPath + ": " + std::strerror(errno);
+    }
+    std::signal(SIGPIPE, SIG_IGN); //a client closing early must not end the service
+    while (true)
+    {
+        int client = accept(listener, nullptr, nullptr);
+        if (client == -1)
+        {
+            if (errno != EINTR)
+            { std::cerr << "accept failed: " << std::strerror(errno) << "\n"; }
+            continue;
+        }
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>(client, client, true);
+        std::thread([this, connection]() { serveConnection(connection); }).detach();
+    }
+}
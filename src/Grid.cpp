@@ -3,94 +3,381 @@
 #include <cmath>
 
 #include <chrono>
-#include <unordered_set>
 #include <limits>
+#include <thread>
+#include <algorithm>
+#include <map>
 
 #include "Error.hpp"
+#include "GridImageWriter.hpp"
+#include "TileMap.hpp"
+#include "CompactGrid.hpp"
 
 //#define LOG_ALL_COLLAPSES
 
-Grid::Grid(std::vector<Tile>& tiles, int height, int width):
+template<uint Words>
+Grid<Words>::Grid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings):
     tiles(tiles),
     height(height),
     width(width),
-    randGen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    propagator(settings.propagator),
+    heuristic(settings.heuristic),
+    backtrackBudget(settings.regionThreads > 1 && settings.backtrackBudget == 0 ? DEFAULT_SEAM_BACKTRACKS : settings.backtrackBudget),
+    allTiles(Field::firstN(tiles.size())),
+    cancel(settings.cancel),
+    progress(settings.progress),
+    log(*settings.log),
+    regionThreads(settings.regionThreads),
+    seamBand(std::max(settings.seamBand, 1)),
+    timePhases(settings.timePhases),
+    cacheEdgeMasks(settings.cacheEdgeMasks),
+    pruneTiles(settings.pruneTiles),
+    topology(height, width, settings.periodic),
+    randGen(settings.seed ? *settings.seed : std::chrono::high_resolution_clock::now().time_since_epoch().count()),
+    entropies(0),
+    dirtyPositions(0)
 {
-    std::bitset<MAX_TILES> bits;
-    for (uint i = 0; i < tiles.size(); i++)
+    validateSettings(settings, tiles.size());
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
     {
-        bits.set(i); //all tiles can be possible at first
+        edgeMasks.push_back({Field::fromWords(tiles[iTile].getEdgeMask(top)), Field::fromWords(tiles[iTile].getEdgeMask(left)),
+            Field::fromWords(tiles[iTile].getEdgeMask(right)), Field::fromWords(tiles[iTile].getEdgeMask(bottom))});
     }
-    fields.resize(height * width, bits);
-    float entropy = calculateEntropy(bits);
-    for (uint i = 0; i < fields.size(); i++)
+    initialWeights = {0, 0};
+    for (const Tile& tile : tiles)
     {
-        entropies.push_back({entropy, i});
+        tileWeights.push_back(tile.getWeight());
+        tileWeightLogWeights.push_back(tile.getWeight() * std::log((double) tile.getWeight()));
+        initialWeights.weight += tile.getWeight();
+        initialWeights.weightLogWeight += tileWeightLogWeights.back();
+    }
+    logSums.push_back(0);
+    for (uint sum = 1; sum <= initialWeights.weight; sum++)
+    {
+        logSums.push_back(std::log((float) sum));
+    }
+    if (propagator == Propagator::edgeMasks)
+    {
+        buildMaskTable();
+    }
+    else
+    {
+        //all tiles are possible everywhere at first, so the count only depends on the tile and whether there is a neighbour
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            for (uint iTile = 0; iTile < tiles.size(); iTile++)
+            {
+                initialSupports.push_back(edgeMasks[iTile][dir].count());
+            }
+        }
+        //the same masks as lists, a removal walks only the tiles it supported instead of every word of the mask
+        for (uint iTile = 0; iTile < tiles.size(); iTile++)
+        {
+            for (uint dir = 0; dir < 4; dir++)
+            {
+                supportedStarts.push_back(supportedTiles.size());
+                edgeMasks[iTile][dir].forEach([&](uint iSupported) { supportedTiles.push_back(iSupported); });
+            }
+        }
+        supportedStarts.push_back(supportedTiles.size());
+    }
+    if (pruneTiles)
+    {
+        layoutDomains.resize(TilesetAnalysis::AXIS_LAYOUTS * TilesetAnalysis::AXIS_LAYOUTS);
+    }
+    allocate();
+    initState();
+}
+
+template<uint Words>
+void Grid<Words>::allocate()
+{
+    //resize keeps the capacity, so a grid that shrinks and grows back within its largest size so far doesn't allocate
+    size_t fieldCount = height * width;
+    topology.resize(height, width);
+    fields.resize(fieldCount);
+    weightSums.resize(fieldCount);
+    entropies.resize(fieldCount);
+    dirtyEntropies.resize(fieldCount);
+    dirtyFields.reserve(fieldCount);
+    dirtyPositions.resize(fieldCount);
+    if (heuristic == Heuristic::frontier)
+    {
+        inFrontier.resize(fieldCount);
+    }
+    if (propagator == Propagator::edgeMasks && (cacheEdgeMasks || maskTable.empty()))
+    {
+        combinedEdgeMasks.resize(fieldCount);
+    }
+    if (propagator == Propagator::supportCounts)
+    {
+        supports.resize(fieldCount * 4 * tiles.size());
+        removals.reserve(fieldCount);
+    }
+    if (backtrackBudget > 0)
+    {
+        trailStamps.resize(fieldCount);
+        trail.reserve(fieldCount);
+    }
+    if (pruneTiles)
+    {
+        //the analysis only depends on the tileset and the layout of the size, so each layout is analysed once per grid,
+        //resizing among sizes of 4 or more fields along both axes never analyses again
+        bool periodic = topology.isPeriodic();
+        ClassDomains& layout = layoutDomains[TilesetAnalysis::axisLayout(height, periodic) * TilesetAnalysis::AXIS_LAYOUTS
+            + TilesetAnalysis::axisLayout(width, periodic)];
+        if (!layout.analysed)
+        {
+            TilesetAnalysis analysis = analyseTileset(tiles, height, width, periodic);
+            for (uint rowClass = 0; rowClass < 3; rowClass++)
+            {
+                for (uint columnClass = 0; columnClass < 3; columnClass++)
+                {
+                    layout.domains[rowClass][columnClass] = Field::fromWords(analysis.domains[rowClass][columnClass]);
+                }
+            }
+            layout.pruning = analysis.prunes();
+            layout.analysed = true;
+        }
+        classDomains = &layout;
+    }
+}
+
+template<uint Words>
+void Grid<Words>::initState()
+{
+    std::fill(fields.begin(), fields.end(), allTiles); //all tiles can be possible at first
+    std::fill(weightSums.begin(), weightSums.end(), initialWeights);
+    if (heuristic == Heuristic::entropy)
+    {
+        entropies.fill(calculateEntropy(0));
+    }
+    else if (heuristic == Heuristic::remainingValues)
+    {
+        entropies.fill(tiles.size());
+    }
+    scanCursor = 0;
+    frontier.clear();
+    frontierHead = 0;
+    std::fill(inFrontier.begin(), inFrontier.end(), false);
+    std::fill(dirtyEntropies.begin(), dirtyEntropies.end(), false);
+    dirtyFields.clear();
+    dirtyPositions.clear();
+    std::fill(combinedEdgeMasks.begin(), combinedEdgeMasks.end(), std::array<Field, 4>{allTiles, allTiles, allTiles, allTiles});
+    if (propagator == Propagator::supportCounts)
+    {
+        initSupports();
+    }
+    std::fill(trailStamps.begin(), trailStamps.end(), 0);
+    trail.clear();
+    stamp = 0;
+    decisions.clear();
+    backtracks = 0;
+    constrainedFields.clear();
+    constraintContradiction = false;
+    stats = RunStats();
+    waveChanges = 0;
+    if (pruneTiles && classDomains->pruning)
+    {
+        applyClassDomains();
     }
-    dirtyEntropies.resize(fields.size(), false);
-    combinedEdgeMasks.resize(fields.size(), {bits, bits, bits, bits});
 }
 
-void Grid::run()
+template<uint Words>
+void Grid<Words>::applyClassDomains()
 {
+    bool periodic = topology.isPeriodic();
+    for (int y = 0; y < height; y++)
+    {
+        const std::array<Field, 3>& rowDomains = classDomains->domains[TilesetAnalysis::classOf(y, height, periodic)];
+        for (int x = 0; x < width; x++)
+        {
+            const Field& domain = rowDomains[TilesetAnalysis::classOf(x, width, periodic)];
+            if (domain != allTiles)
+            {
+                restrictField(getIndex({x, y}), domain);
+            }
+        }
+    }
+}
+
+template<uint Words>
+void Grid<Words>::reset(uint64_t seed)
+{
+    randGen.seed(seed);
+    initState();
+}
+
+template<uint Words>
+void Grid<Words>::resize(int newHeight, int newWidth, uint64_t seed)
+{
+    height = newHeight;
+    width = newWidth;
+    allocate();
+    reset(seed);
+}
+
+template<uint Words>
+bool Grid<Words>::run()
+{
+    runStart = std::chrono::steady_clock::now();
+    bool success = solve();
+    if (progress != nullptr)
+    {
+        publishProgress(true, success);
+    }
+    return success;
+}
+
+template<uint Words>
+bool Grid<Words>::solve()
+{
+    lastLap = runStart;
     try {
+        if (constraintContradiction)
+        {
+            log << "The fields required by the surrounding tiles contradict each other\n";
+            throw errors[Error::Code::contradiction];
+        }
+        if (propagator == Propagator::supportCounts)
+        {
+            removeUnsupported();
+            propagateRemovals();
+        }
+        else
+        {
+            for (uint iField : constrainedFields)
+            {
+                //updateField skips decided fields, two of them decided by the constraints side by side only meet here
+                if (!fitsNeighbours(iField))
+                {
+                    constraintContradiction = true;
+                    log << "The fields required by the surrounding tiles contradict each other\n";
+                    throw errors[Error::Code::contradiction];
+                }
+                insertNeighbours(iField);
+            }
+            propagateQueued();
+        }
+        constrainedFields.clear();
+        if (regionThreads > 1)
+        {
+            runRegions();
+        }
+        lap(stats.propagation);
         int collapsed = collapseOne();
+        lap(stats.collapse);
         while (collapsed != -1)
         {
-            propagateChanges(getPosition(collapsed));
+            if (cancel != nullptr && cancel->load(std::memory_order_relaxed))
+            { return false; }
+            propagateOrBacktrack(collapsed);
+            lap(stats.propagation);
+            if (progress != nullptr && progress->due())
+            {
+                publishProgress(false, false);
+            }
             collapsed = collapseOne();
+            lap(stats.collapse);
+        }
+        if (backtracks > 0)
+        {
+            log << "Backtracked " << backtracks << " times\n";
         }
     }
     catch (Error err)
     {
         if (err.code == Error::Code::contradiction)
         {
-            std::cout << err.message << ", drawing anyways\n";
+            log << err.message << "\n";
+            return false;
         }
         else throw err;
     }
-    
-    drawGrid();
+    return true;
 }
 
-void Grid::drawGrid()
+template<uint Words>
+inline void Grid<Words>::lap(std::chrono::nanoseconds& phase)
 {
-    std::vector<std::vector<const Tile*>> tiles2d;
-    for (int y = 0; y < height; y++)
-    {
-        tiles2d.push_back(std::vector<const Tile*>());
+    if (!timePhases)
+    { return; }
+    auto now = std::chrono::steady_clock::now();
+    phase += now - lastLap;
+    lastLap = now;
+}
+
+// the regions don't publish while they run in parallel, the next snapshot contains their fields
+template<uint Words>
+void Grid<Words>::publishProgress(bool finished, bool success)
+{
+    ProgressSnapshot& snapshot = progress->fill(height, width, tiles.size(), [&](uint iField) {
+        uint count = fields[iField].count();
+        return count == 1 ? (int) fields[iField].first() : count == 0 ? CONTRADICTION_TILE : UNDECIDED_TILE;
+    });
+    snapshot.backtracks = backtracks;
+    snapshot.elapsed = std::chrono::steady_clock::now() - runStart;
+    snapshot.finished = finished;
+    snapshot.success = success;
+    progress->publish();
+}
+
+template<uint Words>
+RunStats Grid<Words>::getStats() const
+{
+    RunStats result = stats;
+    result.backtracks = backtracks;
+    return result;
+}
+
+template<uint Words>
+void Grid<Words>::drawGrid(const std::string& path)
+{
+    //the tiles are looked up row by row while the image is written, see GridImageWriter
+    const Image& first = tiles[0].getImage();
+    GridImageWriter writer(height, width, first.get_height(), first.get_width(), [&](int y, std::vector<const Tile*>& row) {
         for (int x = 0; x < width; x++)
         {
-            if (fields[getIndex({x, y})].count() > 1)
+            const Field& field = fields[getIndex({x, y})];
+            uint count = field.count();
+            if (count > 1)
+            {
+                row[x] = &Tile::getUnknownTile();
+            }
+            else if (count == 0)
             {
-                //std::cout << std::string("field ") << getIndex({x, y}) << " has " << fields[getIndex({x, y})].count() << " possibilities left\n";
-                tiles2d[y].push_back(&Tile::getUnknownTile());
+                row[x] = &Tile::getErrorTile();
             }
             else
             {
-                try
-                {
-                    int iTile = selectFromField(fields[getIndex({x, y})], [](const Tile& t) {return true;});
-                    tiles2d[y].push_back(&(tiles[iTile]));
-                }
-                catch (Error err)
-                {
-                    if (err.code != Error::Code::noElement)
-                        throw err;
-                    tiles2d[y].push_back(&Tile::getErrorTile());
-                }
+                row[x] = &tiles[field.first()];
             }
         }
-    }
-    Tile::drawGrid(tiles2d);
+    });
+    writer.write(path);
 }
 
-Position Grid::getPosition(int i) const
+template<uint Words>
+void Grid<Words>::writeTileMap(const std::string& path)
+{
+    ::writeTileMap(path, height, width, tiles.size(), [&](int y, std::vector<int>& row) {
+        for (int x = 0; x < width; x++)
+        {
+            const Field& field = fields[getIndex({x, y})];
+            uint count = field.count();
+            row[x] = count == 1 ? (int) field.first() : count == 0 ? CONTRADICTION_TILE : UNDECIDED_TILE;
+        }
+    });
+}
+
+template<uint Words>
+Position Grid<Words>::getPosition(int i) const
 {
     return Position{.x = i % width, .y = i / width};
 }
 
-int Grid::getIndex(const Position& pos) const
+template<uint Words>
+int Grid<Words>::getIndex(const Position& pos) const
 {
     return pos.y * width + pos.x;
 }
@@ -100,203 +387,732 @@ int Grid::getIndex(const Position& pos) const
 //     return pos.y * width + pos.x;
 // }
 
-bool Grid::isValid(const Position& pos) const
+
+template<uint Words>
+uint Grid<Words>::selectFromField(const Field& field, const std::function<bool(const Tile&)>& func)
 {
-    return (pos.x >= 0 && pos.x < width
-         && pos.y >= 0 && pos.y < height);
+    for (uint i = field.first(); i < tiles.size(); i++)
+    {
+        if (field[i])
+        {
+            if (func(tiles[i]))
+            {
+                return i;
+            }
+        }
+    }
+    throw errors[Error::Code::noElement];
+}
+
+template<uint Words>
+inline float Grid<Words>::calculateEntropy(uint field) const
+{
+    const WeightSums& sums = weightSums[field];
+    return logSums[sums.weight] - sums.weightLogWeight / sums.weight;
 }
 
+template<uint Words>
+inline void Grid<Words>::removeWeight(uint field, uint tile)
+{
+    weightSums[field].weight -= tileWeights[tile];
+    weightSums[field].weightLogWeight -= tileWeightLogWeights[tile];
+}
+
+template<uint Words>
+void Grid<Words>::removeWeights(uint field, const Field& removed)
+{
+    removed.forEach([&](uint iTile) {
+        removeWeight(field, iTile);
+    });
+}
 
-void Grid::forEachInField(const std::bitset<MAX_TILES>& field, const std::function<void(const Tile&)>& func)
+template<uint Words>
+void Grid<Words>::addWeights(uint field, const Field& added)
 {
-    for (uint i = 0; i < tiles.size(); i++)
+    added.forEach([&](uint iTile) {
+        weightSums[field].weight += tileWeights[iTile];
+        weightSums[field].weightLogWeight += tileWeightLogWeights[iTile];
+    });
+}
+
+template<uint Words>
+void Grid<Words>::updateEntropies()
+{
+    for (uint iField : dirtyFields)
     {
-        if (field[i])
+        dirtyEntropies[iField] = false;
+        if (fields[iField].count() <= 1)
+        {
+            entropies.remove(iField); //determined, no need to keep entropy
+        }
+        else if (heuristic == Heuristic::remainingValues)
         {
-            func(tiles[i]);
+            //the counts tie all the time, without noise the lowest index would win and the grid would fill row by row
+            entropies.update(iField, fields[iField].count() + std::uniform_real_distribution<float>(0, 0.5f)(randGen));
+        }
+        else
+        {
+            COUNT(stats.counters.entropyRecomputes++);
+            entropies.update(iField, calculateEntropy(iField));
         }
     }
+    dirtyFields.clear();
 }
 
-uint Grid::selectFromField(const std::bitset<MAX_TILES>& field, const std::function<bool(const Tile&)>& func)
+template<uint Words>
+void Grid<Words>::updateFrontier()
 {
-    for (uint i = 0; i < tiles.size(); i++)
+    for (uint iField : dirtyFields)
     {
-        if (field[i])
+        dirtyEntropies[iField] = false;
+        if (fields[iField].count() != 1)
+        { continue; }
+        for (uint iNeighbour : topology.neighboursOf(iField))
         {
-            if (func(tiles[i]))
+            if (iNeighbour == Topology::NO_NEIGHBOUR)
+            { continue; }
+            if (!inFrontier[iNeighbour] && fields[iNeighbour].count() > 1)
             {
-                return i;
+                inFrontier[iNeighbour] = true;
+                frontier.push_back(iNeighbour);
             }
         }
     }
-    throw errors[Error::Code::noElement];
+    dirtyFields.clear();
 }
 
-float Grid::calculateEntropy(const std::bitset<MAX_TILES>& field)
+template<uint Words>
+int Grid<Words>::nextInScanline()
 {
-    int count = 0;
-    float sumWeight = 0;
-    float sumWeightLogWeight = 0;
-    forEachInField(field, [&](const Tile& t) {
-        count++;
-        sumWeight += t.getWeight();
-        sumWeightLogWeight += t.getWeight() * log(t.getWeight());
-    });
-    if (count == 1)
-    { return 0; }
-    return log(sumWeight) - sumWeightLogWeight / sumWeight;
+    while (scanCursor < fields.size() && fields[scanCursor].count() <= 1)
+    {
+        scanCursor++;
+    }
+    return scanCursor < fields.size() ? (int) scanCursor : -1;
 }
 
-float Grid::checkEntropy(int iEntropy)
+template<uint Words>
+int Grid<Words>::selectField()
 {
-    uint iField = entropies[iEntropy].second;
-    if (dirtyEntropies[iField])
+    if (heuristic == Heuristic::entropy || heuristic == Heuristic::remainingValues)
     {
-        entropies[iEntropy].first = calculateEntropy(fields[iField]);
-        dirtyEntropies[iField] = false;
+        updateEntropies();
+        return entropies.empty() ? -1 : (int) entropies.top().second;
+    }
+    if (heuristic == Heuristic::scanline)
+    {
+        for (uint iField : dirtyFields)
+        {
+            dirtyEntropies[iField] = false;
+        }
+        dirtyFields.clear();
+        return nextInScanline();
     }
-    return entropies[iEntropy].first;
+    updateFrontier();
+    while (frontierHead < frontier.size())
+    {
+        uint iField = frontier[frontierHead++];
+        inFrontier[iField] = false;
+        if (fields[iField].count() > 1)
+        {
+            //drop the taken part once it is the larger one, so the queue stays at the size of the frontier
+            if (frontierHead * 2 > frontier.size())
+            {
+                frontier.erase(frontier.begin(), frontier.begin() + frontierHead);
+                frontierHead = 0;
+            }
+            return iField;
+        }
+    }
+    frontier.clear();
+    frontierHead = 0;
+    //nothing decided yet or only enclosed areas left, e.g. after backtracking: start a new patch
+    return nextInScanline();
 }
 
-void Grid::clearCache(uint index)
+template<uint Words>
+void Grid<Words>::clearCache(uint index)
 {
-    const std::array<std::bitset<MAX_TILES>, 4> empty {std::bitset<MAX_TILES>(), std::bitset<MAX_TILES>(), std::bitset<MAX_TILES>(), std::bitset<MAX_TILES>()};
-    dirtyEntropies[index] = true;
-    combinedEdgeMasks[index] = empty;
+    if (!dirtyEntropies[index])
+    {
+        dirtyEntropies[index] = true;
+        dirtyFields.push_back(index);
+    }
+    clearMaskCache(index);
 }
 
-
-inline void eraseElems(std::vector<std::pair<float, uint>>& vec)
+template<uint Words>
+inline void Grid<Words>::clearMaskCache(uint index)
 {
-    auto it = std::remove_if(vec.begin(), vec.end(), [&](std::pair<float, uint> pair) { return pair.first <= 0; });
-    vec.erase(it, vec.end());
-    //vec.erase(vec.begin() + i);
+    if (!combinedEdgeMasks.empty())
+    {
+        combinedEdgeMasks[index] = {};
+    }
 }
 
-int Grid::collapseOne()
+template<uint Words>
+void Grid<Words>::buildMaskTable()
 {
-    int iFieldMinEntropy = -1;
-    float minEntropy = std::numeric_limits<float>::infinity();
-    for (uint iEntropy = 0; iEntropy < entropies.size(); iEntropy++)
+    maskTableSlices = (tiles.size() + 7) / 8;
+    if (4 * maskTableSlices * 256 * sizeof(Field) > MAX_MASK_TABLE_BYTES)
     {
-        float entropy = checkEntropy(iEntropy);
-        if (entropy > 0 && entropy < minEntropy)
+        buildMaskClasses();
+        return;
+    }
+    maskTable.resize(4 * maskTableSlices * 256);
+    for (uint dir = 0; dir < 4; dir++)
+    {
+        for (uint slice = 0; slice < maskTableSlices; slice++)
         {
-            minEntropy = entropy;
-            iFieldMinEntropy = entropies[iEntropy].second;
+            Field* table = &maskTable[(dir * maskTableSlices + slice) * 256];
+            for (uint byte = 1; byte < 256; byte++)
+            {
+                //the byte without its lowest bit was filled in before
+                uint iTile = slice * 8 + std::countr_zero(byte);
+                table[byte] = table[byte & (byte - 1)];
+                if (iTile < tiles.size())
+                {
+                    table[byte] |= edgeMasks[iTile][dir];
+                }
+            }
         }
     }
-    if (iFieldMinEntropy != -1)
+}
+
+template<uint Words>
+void Grid<Words>::buildMaskClasses()
+{
+    maskClasses.resize(4 * tiles.size());
+    for (uint dir = 0; dir < 4; dir++)
     {
-        #ifndef LOG_ALL_COLLAPSES
-        if ((iFieldMinEntropy & (4096-1)) == 0)
-        #endif
-        {   std::cout << "collapsing field " << iFieldMinEntropy << "\n"; }
-        collapseField(fields[iFieldMinEntropy]);
-        clearCache(iFieldMinEntropy);
+        std::map<std::vector<uint64_t>, uint> classIndices;
+        for (uint iTile = 0; iTile < tiles.size(); iTile++)
+        {
+            auto [it, inserted] = classIndices.emplace(tiles[iTile].getEdgeMask(static_cast<EdgeDirection>(dir)), classMasks[dir].size());
+            if (inserted)
+            {
+                classMasks[dir].push_back(edgeMasks[iTile][dir]);
+            }
+            maskClasses[dir * tiles.size() + iTile] = it->second;
+        }
     }
-    eraseElems(entropies); //remove fields that have been determined, no need to keep entropy
-    return iFieldMinEntropy;
 }
 
-void Grid::collapseField(std::bitset<MAX_TILES>& field)
+template<uint Words>
+typename Grid<Words>::Field Grid<Words>::combineEdgeMasks(const Field& field, EdgeDirection edge) const
 {
-    int sumWeight = 0;
-    forEachInField(field, [&](const Tile& t) {
-        sumWeight += t.getWeight();
-    });
-    int rnd = randGen() % sumWeight;
-    
-    uint iTile = selectFromField(field, [&](const Tile& t) -> bool {
-        if (rnd < t.getWeight())
+    Field mask;
+    if (maskTable.empty())
+    {
+        //collect the classes first, so every distinct mask is combined once however many of its tiles are possible
+        Field present;
+        const uint16_t* classes = &maskClasses[edge * tiles.size()];
+        field.forEach([&](uint iTile) {
+            present.set(classes[iTile]);
+        });
+        present.forEach([&](uint iClass) {
+            mask |= classMasks[edge][iClass];
+        });
+        return mask;
+    }
+    //one lookup per byte with any tile in it, at most 8 per word however many tiles are possible
+    const Field* table = &maskTable[edge * maskTableSlices * 256];
+    for (uint i = 0; i < Words; i++)
+    {
+        for (uint64_t bits = field.words[i]; bits != 0;)
         {
-            return true;
+            uint shift = std::countr_zero(bits) & ~7u;
+            mask |= table[(i * 8 + shift / 8) * 256 + ((bits >> shift) & 0xff)];
+            bits &= ~(uint64_t(0xff) << shift);
         }
-        rnd -= t.getWeight();
+    }
+    return mask;
+}
+
+
+template<uint Words>
+int Grid<Words>::collapseOne()
+{
+    int iFieldSelected = selectField();
+    if (iFieldSelected == -1)
+    { return -1; }
+    #ifdef LOG_ALL_COLLAPSES
+    log << "collapsing field " << iFieldSelected << "\n";
+    #endif
+    Field before = fields[iFieldSelected];
+    if (backtrackBudget > 0)
+    {
+        stamp++;
+        decisions.push_back({trail.size(), (uint) iFieldSelected, 0});
+        recordChange(iFieldSelected);
+    }
+    fields[iFieldSelected] = collapseField(iFieldSelected, randGen);
+    COUNT(stats.counters.decisions++);
+    if (backtrackBudget > 0)
+    {
+        decisions.back().tile = fields[iFieldSelected].first();
+    }
+    clearCache(iFieldSelected);
+    if (propagator == Propagator::supportCounts)
+    {
+        queueRemovals(iFieldSelected, before.without(fields[iFieldSelected]));
+    }
+    return iFieldSelected;
+}
+
+template<uint Words>
+typename Grid<Words>::Field Grid<Words>::collapseField(uint iField, std::mt19937& rng)
+{
+    //rng() % sumWeight would favour the low numbers whenever the range of rng is no multiple of sumWeight
+    uint rnd = std::uniform_int_distribution<uint>(0, weightSums[iField].weight - 1)(rng);
+    uint iTile = fields[iField].findIf([&](uint i) {
+        if (rnd < tileWeights[i])
+        { return true; }
+        rnd -= tileWeights[i];
         return false;
     });
-    field.reset();
+    weightSums[iField] = {tileWeights[iTile], tileWeightLogWeights[iTile]};
+    Field field;
     field.set(iTile);
     #ifdef LOG_ALL_COLLAPSES
-    std::cout << "collapsed field to " << tiles[iTile].getName() << std::endl;
+    log << "collapsed field to " << tiles[iTile].getName() << std::endl;
     #endif
+    return field;
 }
 
-void Grid::insertNeighbours(std::unordered_set<int>& set, const Position& pos) const
+template<uint Words>
+void Grid<Words>::insertNeighbours(uint field)
 {
-    if (isValid(pos.get(top))) set.insert(getIndex(pos.get(top)));
-    if (isValid(pos.get(right))) set.insert(getIndex(pos.get(right)));
-    if (isValid(pos.get(left))) set.insert(getIndex(pos.get(left)));
-    if (isValid(pos.get(bottom))) set.insert(getIndex(pos.get(bottom)));
+    const std::array<uint, 4>& neighbours = topology.neighboursOf(field);
+    if (neighbours[top] != Topology::NO_NEIGHBOUR) dirtyPositions.push(neighbours[top]);
+    if (neighbours[right] != Topology::NO_NEIGHBOUR) dirtyPositions.push(neighbours[right]);
+    if (neighbours[left] != Topology::NO_NEIGHBOUR) dirtyPositions.push(neighbours[left]);
+    if (neighbours[bottom] != Topology::NO_NEIGHBOUR) dirtyPositions.push(neighbours[bottom]);
 }
 
-void Grid::propagateChanges(Position startPos)
+template<uint Words>
+void Grid<Words>::propagateChanges(uint startField)
+{
+    COUNT(waveChanges = 0);
+    if (propagator == Propagator::supportCounts)
+    {
+        propagateRemovals(); //the collapse already queued its removed tiles
+    }
+    else
+    {
+        insertNeighbours(startField);
+        propagateQueued();
+    }
+    COUNT(stats.counters.recordWave(waveChanges));
+}
+
+template<uint Words>
+void Grid<Words>::propagateQueued()
 {
-    // auto hash = [&width](const Position& pos) { return std::hash<uint>{}()}
-    std::unordered_set<int> dirtyPositions; //may contain indices out of range
-    insertNeighbours(dirtyPositions, startPos);
     while (!dirtyPositions.empty())
     {
-        auto it = dirtyPositions.begin();
-        Position pos = getPosition(*it);
-        dirtyPositions.erase(it);
-        if (inBounds(pos) && updateField(pos))
+        uint iField = dirtyPositions.pop();
+        COUNT(stats.counters.updateCalls++);
+        if (updateField(iField))
+        {
+            COUNT(stats.counters.updateChanges++);
+            COUNT(waveChanges++);
+            COUNT(stats.counters.propagatedSingletons += fields[iField].count() == 1);
+            clearCache(iField);
+            insertNeighbours(iField);
+        }
+    }
+}
+
+template<uint Words>
+inline uint16_t& Grid<Words>::support(uint field, EdgeDirection dir, uint tile)
+{
+    return supports[(field * 4 + dir) * tiles.size() + tile];
+}
+
+template<uint Words>
+template<typename Func>
+inline void Grid<Words>::forEachSupported(uint tile, EdgeDirection dir, Func func) const
+{
+    const uint16_t* end = &supportedTiles[0] + supportedStarts[tile * 4 + dir + 1];
+    for (const uint16_t* it = &supportedTiles[0] + supportedStarts[tile * 4 + dir]; it != end; it++)
+    {
+        func(*it);
+    }
+}
+
+template<uint Words>
+void Grid<Words>::initSupports()
+{
+    removals.clear();
+    for (uint iField = 0; iField < fields.size(); iField++)
+    {
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            uint16_t* counts = &support(iField, static_cast<EdgeDirection>(dir), 0);
+            if (topology.neighbour(iField, static_cast<EdgeDirection>(dir)) != Topology::NO_NEIGHBOUR)
+            {
+                std::copy_n(&initialSupports[dir * tiles.size()], tiles.size(), counts);
+            }
+            else
+            {
+                //without a neighbour nothing ever decrements the count, it only must not start at 0
+                std::fill_n(counts, tiles.size(), 1);
+            }
+        }
+    }
+}
+
+template<uint Words>
+void Grid<Words>::removeUnsupported()
+{
+    for (uint iField = 0; iField < fields.size(); iField++)
+    {
+        Field unsupported;
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            for (uint iTile = 0; iTile < tiles.size(); iTile++)
+            {
+                if (fields[iField][iTile] && support(iField, static_cast<EdgeDirection>(dir), iTile) == 0)
+                {
+                    unsupported.set(iTile);
+                }
+            }
+        }
+        if (unsupported.none())
+        { continue; }
+        Position pos = getPosition(iField);
+        recordChange(iField);
+        fields[iField].andNot(unsupported);
+        removeWeights(iField, unsupported);
+        if (fields[iField].none())
+        {
+            log << "Contradiction in Field " << pos.x << "|" << pos.y << " (" << iField << ")\n";
+            throw errors[Error::Code::contradiction];
+        }
+        clearCache(iField);
+        queueRemovals(iField, unsupported);
+    }
+}
+
+template<uint Words>
+void Grid<Words>::queueRemovals(uint field, const Field& removed)
+{
+    removed.forEach([&](uint iTile) {
+        removals.push_back({field, iTile});
+    });
+}
+
+template<uint Words>
+void Grid<Words>::propagateRemovals()
+{
+    while (!removals.empty())
+    {
+        auto [iField, iTile] = removals.back();
+        removals.pop_back();
+        int contradiction = -1; //all counts of this removal are decremented before throwing, so backtracking finds them consistent
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            EdgeDirection edge = static_cast<EdgeDirection>(dir);
+            uint iNeighbour = topology.neighbour(iField, edge);
+            if (iNeighbour == Topology::NO_NEIGHBOUR)
+            { continue; }
+            Field& neighbour = fields[iNeighbour];
+            //the removed tile supported every tile of its edge mask on that side
+            uint16_t* counts = &support(iNeighbour, opposite(edge), 0);
+            forEachSupported(iTile, edge, [&](uint iSupported) {
+                if (--counts[iSupported] != 0 || !neighbour[iSupported])
+                { return; }
+                recordChange(iNeighbour);
+                neighbour.reset(iSupported);
+                removeWeight(iNeighbour, iSupported);
+                COUNT(stats.counters.tileRemovals++);
+                COUNT(waveChanges++);
+                COUNT(stats.counters.propagatedSingletons += neighbour.count() == 1);
+                if (neighbour.none())
+                {
+                    contradiction = iNeighbour;
+                }
+                clearCache(iNeighbour);
+                removals.push_back({iNeighbour, iSupported});
+            });
+        }
+        if (contradiction != -1)
+        {
+            Position contradictionPos = getPosition(contradiction);
+            log << "Contradiction in Field " << contradictionPos.x << "|" << contradictionPos.y << " (" << contradiction << ")\n";
+            throw errors[Error::Code::contradiction];
+        }
+    }
+}
+
+template<uint Words>
+inline void Grid<Words>::recordChange(uint field)
+{
+    if (backtrackBudget > 0 && trailStamps[field] != stamp)
+    {
+        trail.push_back({field, fields[field]});
+        trailStamps[field] = stamp;
+    }
+}
+
+template<uint Words>
+void Grid<Words>::discardPending()
+{
+    dirtyPositions.clear();
+    //removed tiles still have to leave the support counts, but without removing further tiles
+    for (auto [iField, iTile] : removals)
+    {
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            EdgeDirection edge = static_cast<EdgeDirection>(dir);
+            uint iNeighbour = topology.neighbour(iField, edge);
+            if (iNeighbour == Topology::NO_NEIGHBOUR)
+            { continue; }
+            uint16_t* counts = &support(iNeighbour, opposite(edge), 0);
+            forEachSupported(iTile, edge, [&](uint iSupported) { counts[iSupported]--; });
+        }
+    }
+    removals.clear();
+}
+
+template<uint Words>
+void Grid<Words>::unwind(size_t trailSize)
+{
+    while (trail.size() > trailSize)
+    {
+        auto& [iField, before] = trail.back();
+        if (propagator == Propagator::supportCounts)
+        {
+            //give the restored tiles their support back, the reverse of propagateRemovals
+            before.without(fields[iField]).forEach([&](uint iTile) {
+                for (uint dir = 0; dir < 4; dir++)
+                {
+                    EdgeDirection edge = static_cast<EdgeDirection>(dir);
+                    uint iNeighbour = topology.neighbour(iField, edge);
+                    if (iNeighbour == Topology::NO_NEIGHBOUR)
+                    { continue; }
+                    uint16_t* counts = &support(iNeighbour, opposite(edge), 0);
+                    forEachSupported(iTile, edge, [&](uint iSupported) { counts[iSupported]++; });
+                }
+            });
+        }
+        addWeights(iField, before.without(fields[iField]));
+        fields[iField] = before;
+        scanCursor = std::min(scanCursor, iField);
+        clearCache(iField);
+        trail.pop_back();
+    }
+}
+
+// undoes the last decision and bans its tile from the field, returns the field to propagate from or -1 if the budget is used up
+template<uint Words>
+int Grid<Words>::backtrack()
+{
+    while (!decisions.empty() && backtracks < backtrackBudget)
+    {
+        backtracks++;
+        Decision decision = decisions.back();
+        decisions.pop_back();
+        discardPending();
+        unwind(decision.trailSize);
+        stamp++; //the ban belongs to the previous decision, it is undone with it
+        recordChange(decision.field);
+        fields[decision.field].reset(decision.tile);
+        removeWeight(decision.field, decision.tile);
+        if (fields[decision.field].none())
+        { continue; } //every tile was tried, the previous decision was wrong too
+        clearCache(decision.field);
+        if (propagator == Propagator::supportCounts)
         {
-            clearCache(getIndex(pos));
-            insertNeighbours(dirtyPositions, pos);
+            Field banned;
+            banned.set(decision.tile);
+            queueRemovals(decision.field, banned);
         }
+        return decision.field;
     }
+    return -1;
 }
 
-bool Grid::updateField(Position pos)
+template<uint Words>
+void Grid<Words>::propagateOrBacktrack(int collapsed)
 {
-    if (fields[getIndex(pos)].count() == 1)
+    while (true)
+    {
+        try
+        {
+            propagateChanges(collapsed);
+            return;
+        }
+        catch (Error err)
+        {
+            if (err.code != Error::Code::contradiction || backtrackBudget == 0)
+            { throw err; }
+            collapsed = backtrack();
+            if (collapsed == -1)
+            { throw err; }
+        }
+    }
+}
+
+template<uint Words>
+bool Grid<Words>::fitsNeighbours(uint iField)
+{
+    const std::array<uint, 4>& neighbours = topology.neighboursOf(iField);
+    return (fields[iField] & combinedEdgeMask(neighbours[top], bottom) & combinedEdgeMask(neighbours[right], left)
+        & combinedEdgeMask(neighbours[left], right) & combinedEdgeMask(neighbours[bottom], top)).any();
+}
+
+template<uint Words>
+bool Grid<Words>::updateField(uint iField)
+{
+    if (fields[iField].count() == 1)
+    { return false; }
+    Field before = fields[iField];
+    const std::array<uint, 4>& neighbours = topology.neighboursOf(iField);
+    Field updated = before & combinedEdgeMask(neighbours[top], bottom) & combinedEdgeMask(neighbours[right], left)
+    & combinedEdgeMask(neighbours[left], right) & combinedEdgeMask(neighbours[bottom], top);
+    if (updated == before)
     { return false; }
-    std::bitset<MAX_TILES> before = fields[getIndex(pos)];
-    fields[getIndex(pos)] = combinedEdgeMask(pos.get(top), bottom) & combinedEdgeMask(pos.get(right), left)
-    & combinedEdgeMask(pos.get(left), right) & combinedEdgeMask(pos.get(bottom), top);
-    //if (before != fields[getIndex(pos)]) std::cout << pos << " before:\n" << before << ", after:\n" << fields[getIndex(pos)] << "\n";
-    if (fields[getIndex(pos)].none())
+    recordChange(iField);
+    fields[iField] = updated;
+    removeWeights(iField, before.without(updated));
+    //if (before != fields[iField]) std::cout << pos << " before:\n" << before << ", after:\n" << fields[iField] << "\n";
+    if (fields[iField].none())
     {
-        std::cout << "Contradiction in Field " << pos.x << "|" << pos.y << " (" << getIndex(pos) << ")\n";
+        Position pos = getPosition(iField);
+        log << "Contradiction in Field " << pos.x << "|" << pos.y << " (" << iField << ")\n";
         throw errors[Error::Code::contradiction];
     }
     #ifdef LOG_ALL_COLLAPSES
-    if (fields[getIndex(pos)].count() == 1)
+    if (fields[iField].count() == 1)
+    {
+        log << "field " << iField << " resulted to be " << tiles[selectFromField(fields[iField], [](const Tile& t) { return true; } )].getName() << std::endl;
+    }
+    #endif
+    return true;
+}
+
+// collapses everything but the seams between strips of rows in parallel, the caller continues sequentially with the rest
+template<uint Words>
+void Grid<Words>::runRegions()
+{
+    int regionCount = std::min(regionThreads, height / (2 * seamBand + 1));
+    if (regionCount < 2)
+    { return; }
+    RegionSync sync;
+    sync.workers = regionCount;
+    sync.cancel = cancel;
+    std::vector<std::unique_ptr<SpscQueue>> downwards, upwards; //[i]: between region i and i + 1
+    for (int i = 0; i < regionCount - 1; i++)
+    {
+        downwards.push_back(std::make_unique<SpscQueue>(2 * width));
+        upwards.push_back(std::make_unique<SpscQueue>(2 * width));
+    }
+    std::vector<std::unique_ptr<RegionWorker<Words>>> workers;
+    for (int i = 0; i < regionCount; i++)
+    {
+        int firstRow = height * i / regionCount;
+        int endRow = height * (i + 1) / regionCount;
+        int firstCollapseRow = i > 0 ? firstRow + seamBand : firstRow;
+        int endCollapseRow = i < regionCount - 1 ? endRow - seamBand : endRow;
+        workers.push_back(std::make_unique<RegionWorker<Words>>(*this, sync, firstRow, endRow, firstCollapseRow, endCollapseRow, randGen()));
+        workers[i]->connect(i > 0 ? downwards[i - 1].get() : nullptr, i > 0 ? upwards[i - 1].get() : nullptr,
+            i < regionCount - 1 ? upwards[i].get() : nullptr, i < regionCount - 1 ? downwards[i].get() : nullptr);
+    }
+    std::vector<std::thread> threads;
+    for (auto& worker : workers)
+    {
+        threads.emplace_back([&worker] { worker->run(); });
+    }
+    for (std::thread& thread : threads)
     {
-        std::cout << "field " << getIndex(pos) << " resulted to be " << tiles[selectFromField(fields[getIndex(pos)].count(), [](const Tile& t) { return true; } )].getName() << std::endl;
+        thread.join();
+    }
+    #ifdef WFC_STATS
+    for (auto& worker : workers)
+    {
+        stats.counters += worker->getCounters();
     }
     #endif
-    return before != fields[getIndex(pos)];
+    stats.stripFailures += sync.stripFailures;
+    if (sync.failed)
+    {
+        throw errors[Error::Code::contradiction];
+    }
+    for (uint iField = 0; iField < fields.size(); iField++)
+    {
+        clearCache(iField); //the workers kept their own entropies, the seams are picked up from here
+    }
+}
+
+template<uint Words>
+void Grid<Words>::requireNeighbour(int x, int y, EdgeDirection side, uint tile)
+{
+    restrictField(getIndex({x, y}), edgeMasks[tile][opposite(side)]);
 }
 
-bool Grid::inBounds(Position pos)
+template<uint Words>
+void Grid<Words>::applyConstraints(const Constraints& constraints)
 {
-    return pos.y >= 0 && pos.y < height && pos.x >= 0 && pos.x < width;
+    forEachConstraint(constraints, height, width, tiles.size(), [&](uint iField, const std::vector<uint64_t>& allowed) {
+        restrictField(iField, Field::fromWords(allowed));
+    });
 }
 
-std::bitset<MAX_TILES> Grid::combinedEdgeMask(Position pos, EdgeDirection edge)
+template<uint Words>
+void Grid<Words>::restrictField(uint iField, const Field& allowed)
 {
-    std::bitset<MAX_TILES> mask;
-    if (!inBounds(pos))
+    Field removed = fields[iField].without(allowed);
+    if (removed.none())
+    { return; }
+    recordChange(iField);
+    fields[iField] &= allowed;
+    removeWeights(iField, removed);
+    clearCache(iField);
+    if (fields[iField].none())
     {
-        mask.set();
-        return mask;
+        constraintContradiction = true;
+    }
+    if (propagator == Propagator::supportCounts)
+    {
+        queueRemovals(iField, removed);
     }
-    mask = combinedEdgeMasks[getIndex(pos)][edge];
-    
+    else
+    {
+        constrainedFields.push_back(iField);
+    }
+}
+
+template<uint Words>
+int Grid<Words>::getTile(int x, int y) const
+{
+    const Field& field = fields[getIndex({x, y})];
+    return field.count() == 1 ? (int) field.first() : -1;
+}
+
+template<uint Words>
+typename Grid<Words>::Field Grid<Words>::combinedEdgeMask(uint iField, EdgeDirection edge)
+{
+    if (iField == Topology::NO_NEIGHBOUR)
+    {
+        return allTiles;
+    }
+    if (combinedEdgeMasks.empty())
+    {
+        COUNT(stats.counters.maskRecomputes++);
+        return combineEdgeMasks(fields[iField], edge);
+    }
+    Field mask = combinedEdgeMasks[iField][edge];
     if (mask.any())
     {
+        COUNT(stats.counters.maskCacheHits++);
         return mask;
     }
+    COUNT(stats.counters.maskRecomputes++);
     //std::cout << "accessing field " << std::distance(fields.begin(), ((*this)[pos.y]+pos.x)) << '\n';
-    std::bitset<MAX_TILES> field = fields[getIndex(pos)];
-    forEachInField(field, [&] (const Tile& t) {
-       mask |= t.getEdgeMask(edge); 
-       //std::cout << t.getName() << " mask:\n" << t.getEdgeMask(edge) << std::endl;
-    });
-    combinedEdgeMasks[getIndex(pos)][edge] = mask;
+    mask = combineEdgeMasks(fields[iField], edge);
+    combinedEdgeMasks[iField][edge] = mask;
     //std::cout << pos << " combined edge mask in direction " << edge << ":\n" << mask << std::endl; 
     // for (uint i = 0; i < tiles.size(); i++)
     // {
@@ -313,4 +1129,65 @@ std::bitset<MAX_TILES> Grid::combinedEdgeMask(Position pos, EdgeDirection edge)
 // {
 //     //std::cout << "accessing row starting at " << std::distance( fields.begin(), fields.begin() + y * width ) << '\n';
 //     return fields.begin() + y * width;
-// }
\ No newline at end of file
+// }
+
+
+void validateSettings(const GridSettings& settings, uint tileCount)
+{
+    if (tileCount > MAX_TILES)
+    {
+        throw std::string("More tiles (") + std::to_string(tileCount) + ") than the widest domain can hold";
+    }
+    if (settings.compact)
+    {
+        if (settings.propagator != Propagator::edgeMasks || settings.heuristic != Heuristic::entropy || settings.backtrackBudget > 0
+            || settings.regionThreads > 1 || settings.pruneTiles || settings.periodic)
+        {
+            throw std::string("The compact grid only supports the edge mask propagator and the entropy heuristic, without backtracking, regions, pruning or periodic borders");
+        }
+        return;
+    }
+    if (settings.regionThreads > 1 && settings.propagator != Propagator::edgeMasks)
+    {
+        throw std::string("Parallel regions only support the edge mask propagator");
+    }
+    if (settings.regionThreads > 1 && settings.heuristic != Heuristic::entropy)
+    {
+        throw std::string("Parallel regions only support the entropy heuristic");
+    }
+    if (settings.regionThreads > 1 && settings.periodic)
+    {
+        throw std::string("Parallel regions don't support periodic grids");
+    }
+}
+
+template<template<uint> class GridType>
+static std::unique_ptr<GridBase> makeGridOfWidth(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings)
+{
+    uint words = (tiles.size() + 63) / 64;
+    if (words <= 1) return std::make_unique<GridType<1>>(tiles, height, width, settings);
+    if (words <= 2) return std::make_unique<GridType<2>>(tiles, height, width, settings);
+    if (words <= 4) return std::make_unique<GridType<4>>(tiles, height, width, settings);
+    if (words <= 8) return std::make_unique<GridType<8>>(tiles, height, width, settings);
+    if (words <= 16) return std::make_unique<GridType<16>>(tiles, height, width, settings);
+    if (words <= 32) return std::make_unique<GridType<32>>(tiles, height, width, settings);
+    if (words <= 64) return std::make_unique<GridType<64>>(tiles, height, width, settings);
+    throw std::string("More tiles (") + std::to_string(tiles.size()) + ") than the widest domain can hold";
+}
+
+std::unique_ptr<GridBase> makeGrid(const std::vector<Tile>& tiles, int height, int width, const GridSettings& settings)
+{
+    if (settings.compact)
+    {
+        return makeGridOfWidth<CompactGrid>(tiles, height, width, settings);
+    }
+    return makeGridOfWidth<Grid>(tiles, height, width, settings);
+}
+
+template class Grid<1>;
+template class Grid<2>;
+template class Grid<4>;
+template class Grid<8>;
+template class Grid<16>;
+template class Grid<32>;
+template class Grid<64>;
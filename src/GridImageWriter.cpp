@@ -0,0 +1,43 @@
+#include "GridImageWriter.hpp"
+
+#include <fstream>
+#include <algorithm>
+
+GridImageWriter::GridImageWriter(int height, int width, uint tileHeight, uint tileWidth, RowSource rowSource):
+    png::generator<png::rgb_pixel, GridImageWriter>(width * tileWidth, height * tileHeight),
+    height(height),
+    width(width),
+    tileHeight(tileHeight),
+    tileWidth(tileWidth),
+    rowSource(rowSource),
+    tileRow(width),
+    scanline(width * tileWidth)
+{}
+
+void GridImageWriter::write(const std::string& path)
+{
+    std::ofstream stream(path, std::ios::binary);
+    if (!stream.is_open())
+    {
+        throw png::std_error(path);
+    }
+    stream.exceptions(std::ios::badbit);
+    png::generator<png::rgb_pixel, GridImageWriter>::write(stream);
+}
+
+png::byte* GridImageWriter::get_next_row(png::uint_32 pos)
+{
+    int y = pos / tileHeight;
+    if (y != currentRow)
+    {
+        rowSource(y, tileRow);
+        currentRow = y;
+    }
+    uint tilePixelRow = pos % tileHeight;
+    for (int x = 0; x < width; x++)
+    {
+        const auto& pixels = tileRow[x]->getImage()[tilePixelRow];
+        std::copy(pixels.begin(), pixels.begin() + tileWidth, scanline.begin() + x * tileWidth);
+    }
+    return reinterpret_cast<png::byte*>(scanline.data());
+}
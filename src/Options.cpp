@@ -0,0 +1,131 @@
+#include "Options.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+
+void parseArguments(int argc, char *argv[], std::vector<std::string>& positional, std::map<std::string, std::string>& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) == 0)
+        {
+            size_t split = arg.find('=');
+            if (split == std::string::npos)
+            {
+                options[arg.substr(2)] = "";
+            }
+            else
+            {
+                options[arg.substr(2, split - 2)] = arg.substr(split + 1);
+            }
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+}
+
+Propagator parsePropagator(const std::map<std::string, std::string>& options)
+{
+    auto it = options.find("propagator");
+    if (it == options.end() || it->second == "masks")
+    {
+        return Propagator::edgeMasks;
+    }
+    if (it->second == "supports")
+    {
+        return Propagator::supportCounts;
+    }
+    throw std::string("Unknown propagator \"") + it->second + "\", expected masks or supports";
+}
+
+Heuristic parseHeuristic(const std::map<std::string, std::string>& options)
+{
+    auto it = options.find("heuristic");
+    if (it == options.end() || it->second == "entropy")
+    {
+        return Heuristic::entropy;
+    }
+    if (it->second == "mrv")
+    {
+        return Heuristic::remainingValues;
+    }
+    if (it->second == "scanline")
+    {
+        return Heuristic::scanline;
+    }
+    if (it->second == "frontier")
+    {
+        return Heuristic::frontier;
+    }
+    throw std::string("Unknown heuristic \"") + it->second + "\", expected entropy, mrv, scanline or frontier";
+}
+
+GridSettings parseGridSettings(const std::map<std::string, std::string>& options)
+{
+    GridSettings settings;
+    settings.propagator = parsePropagator(options);
+    settings.heuristic = parseHeuristic(options);
+    auto it = options.find("backtracks");
+    if (it != options.end())
+    {
+        settings.backtrackBudget = atoi(it->second.c_str());
+    }
+    it = options.find("regions");
+    if (it != options.end())
+    {
+        settings.regionThreads = atoi(it->second.c_str());
+    }
+    it = options.find("seam");
+    if (it != options.end())
+    {
+        settings.seamBand = atoi(it->second.c_str());
+    }
+    settings.compact = options.count("compact") && options.at("compact") != "0";
+    settings.pruneTiles = options.count("prune") && options.at("prune") != "0";
+    settings.periodic = options.count("periodic") && options.at("periodic") != "0";
+    it = options.find("mask-cache");
+    if (it != options.end())
+    {
+        settings.cacheEdgeMasks = it->second != "0";
+    }
+    return settings;
+}
+
+void parseTileOptions(const std::map<std::string, std::string>& options)
+{
+    auto it = options.find("edge-tolerance");
+    if (it != options.end())
+    {
+        TileEdge::setColourTolerance(atoi(it->second.c_str()));
+    }
+}
+
+uint64_t parseSeed(const std::string& value)
+{
+    //stoull alone would accept leading blanks, a sign and trailing garbage, and throws exceptions nobody catches
+    bool digits = !value.empty() && value.find_first_not_of("0123456789") == std::string::npos;
+    errno = 0;
+    uint64_t seed = digits ? std::strtoull(value.c_str(), nullptr, 10) : 0;
+    if (!digits || errno == ERANGE)
+    {
+        throw std::string("Invalid seed \"") + value + "\", expected a number from 0 to " + std::to_string(UINT64_MAX);
+    }
+    return seed;
+}
+
+std::vector<std::string> splitList(const std::string& list, char separator)
+{
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = list.find(separator, start);
+        items.push_back(list.substr(start, end - start));
+        if (end == std::string::npos)
+        { return items; }
+        start = end + 1;
+    }
+}
@@ -0,0 +1,133 @@
+#include "OverlappingModel.hpp"
+
+#include <array>
+#include <cstring>
+#include <unordered_map>
+
+#include "Tileset.hpp"
+
+typedef std::vector<png::rgb_pixel> Pattern; //n * n pixels, row by row
+
+static void rotate(const Pattern& pattern, int n, Pattern& rotated)
+{
+    for (int y = 0; y < n; y++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            rotated[y * n + x] = pattern[(n - 1 - x) * n + y];
+        }
+    }
+}
+
+static void reflect(const Pattern& pattern, int n, Pattern& reflected)
+{
+    for (int y = 0; y < n; y++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            reflected[y * n + x] = pattern[y * n + n - 1 - x];
+        }
+    }
+}
+
+// the pixels of a rectangle within the pattern, row by row
+static std::vector<png::rgb_pixel> region(const Pattern& pattern, int n, int left, int top, int width, int height)
+{
+    std::vector<png::rgb_pixel> pixels;
+    pixels.reserve(width * height);
+    for (int y = top; y < top + height; y++)
+    {
+        for (int x = left; x < left + width; x++)
+        {
+            pixels.push_back(pattern[y * n + x]);
+        }
+    }
+    return pixels;
+}
+
+std::vector<Tile> createPatternTiles(const std::string& samplePath, int n, int symmetry, bool periodicInput)
+{
+    if (n < 2 || symmetry < 1 || symmetry > 8)
+    {
+        throw std::string("The pattern size has to be at least 2 and the symmetry between 1 and 8");
+    }
+    Image sample;
+    try
+    {
+        sample.read(samplePath);
+    }
+    catch (png::error& e)
+    {
+        throw std::string("Could not read the sample ") + samplePath + ": " + e.what();
+    }
+    int width = sample.get_width();
+    int height = sample.get_height();
+    if (width < n || height < n)
+    {
+        throw std::string("The sample ") + samplePath + " is smaller than a pattern";
+    }
+
+    //patterns are deduplicated through their raw pixels, the variants are reused for every position
+    std::unordered_map<std::string, uint> patternIndices;
+    std::vector<Pattern> patterns;
+    std::vector<int> counts;
+    std::array<Pattern, 8> variants;
+    variants.fill(Pattern(n * n));
+    std::string key(n * n * sizeof(png::rgb_pixel), '\0');
+    int endX = periodicInput ? width : width - n + 1;
+    int endY = periodicInput ? height : height - n + 1;
+    for (int y = 0; y < endY; y++)
+    {
+        for (int x = 0; x < endX; x++)
+        {
+            for (int dy = 0; dy < n; dy++)
+            {
+                for (int dx = 0; dx < n; dx++)
+                {
+                    variants[0][dy * n + dx] = sample[(y + dy) % height][(x + dx) % width];
+                }
+            }
+            //even variants are the rotations, odd ones their reflections
+            for (int i = 1; i < symmetry; i++)
+            {
+                if (i % 2 == 1)
+                { reflect(variants[i - 1], n, variants[i]); }
+                else
+                { rotate(variants[i - 2], n, variants[i]); }
+            }
+            for (int i = 0; i < symmetry; i++)
+            {
+                std::memcpy(key.data(), variants[i].data(), key.size());
+                auto [it, inserted] = patternIndices.emplace(key, patterns.size());
+                if (inserted)
+                {
+                    patterns.push_back(variants[i]);
+                    counts.push_back(0);
+                }
+                counts[it->second]++;
+            }
+        }
+    }
+    if (patterns.size() > MAX_TILES)
+    {
+        throw std::string("The sample has ") + std::to_string(patterns.size()) + " patterns, at most "
+            + std::to_string(MAX_TILES) + " fit into a domain, try a smaller pattern size or symmetry";
+    }
+
+    std::vector<std::unique_ptr<Tile>> tilesPtrs;
+    tilesPtrs.reserve(patterns.size());
+    for (uint i = 0; i < patterns.size(); i++)
+    {
+        const Pattern& pattern = patterns[i];
+        Image pixel(1, 1);
+        pixel[0][0] = pattern[0];
+        //the part a neighbour on that side overlaps with, e.g. the top n - 1 rows are the bottom ones of the pattern above
+        std::array<TileEdge, 4> edges = {
+            TileEdge(region(pattern, n, 0, 0, n, n - 1)),
+            TileEdge(region(pattern, n, 0, 0, n - 1, n)),
+            TileEdge(region(pattern, n, 1, 0, n - 1, n)),
+            TileEdge(region(pattern, n, 0, 1, n, n - 1))};
+        tilesPtrs.push_back(std::make_unique<Tile>(pixel, "Pattern" + std::to_string(i), counts[i], edges, std::array<std::vector<uint64_t>, 4>()));
+    }
+    return matchTileset(tilesPtrs);
+}
@@ -0,0 +1,105 @@
+#include "ParallelRunner.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <iostream>
+
+#include "Error.hpp"
+
+using namespace std::chrono;
+
+ParallelRunner::ParallelRunner(const std::vector<Tile>& tiles, int threadCount):
+    tiles(tiles),
+    pool(threadCount)
+{
+}
+
+RaceResult ParallelRunner::race(int height, int width, GridSettings settings, uint64_t firstSeed, int maxAttempts)
+{
+    //a throw in a pool job would end the process
+    validateSettings(settings, tiles.size());
+    RaceResult result;
+    std::atomic<bool> done(false);
+    std::mutex resultMutex;
+    //the grids only watch done, the caller's flag is passed on to it while the attempts run
+    const std::atomic<bool>* callerCancel = settings.cancel;
+    settings.cancel = &done;
+
+    for (int i = 0; i < maxAttempts; i++)
+    {
+        pool.submit([&, i, settings]() mutable {
+            if (done.load())
+            { return; }
+            settings.seed = firstSeed + i;
+            auto start = high_resolution_clock::now();
+            std::unique_ptr<GridBase> grid;
+            bool success = false;
+            try
+            {
+                grid = makeGrid(tiles, height, width, settings);
+                {
+                    std::lock_guard<std::mutex> lock(resultMutex);
+                    result.attemptsStarted++;
+                }
+                success = grid->run();
+            }
+            catch (...)
+            {
+                std::cerr << "Attempt with seed " << *settings.seed << " failed with an unexpected error\n";
+            }
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (success && !done.exchange(true))
+            {
+                result.winner.seed = *settings.seed;
+                result.winner.success = true;
+                result.winner.duration = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+                result.winner.grid = std::move(grid);
+            }
+            else if (!success && !done.load())
+            {
+                result.contradictions++;
+            }
+        });
+    }
+    while (!pool.waitFor(milliseconds(10)))
+    {
+        if (callerCancel != nullptr && callerCancel->load(std::memory_order_relaxed))
+        {
+            done.store(true);
+        }
+    }
+    return result;
+}
+
+std::vector<Attempt> ParallelRunner::batch(int height, int width, GridSettings settings, uint64_t firstSeed, int count, const std::string& pathPrefix)
+{
+    validateSettings(settings, tiles.size());
+    std::vector<Attempt> attempts(count);
+    for (int i = 0; i < count; i++)
+    {
+        pool.submit([&, i, settings]() mutable {
+            Attempt& attempt = attempts[i];
+            attempt.seed = firstSeed + i;
+            settings.seed = attempt.seed;
+            if (settings.cancel != nullptr && settings.cancel->load(std::memory_order_relaxed))
+            { return; }
+            auto start = high_resolution_clock::now();
+            try
+            {
+                std::unique_ptr<GridBase> grid = makeGrid(tiles, height, width, settings);
+                attempt.success = grid->run();
+                if (attempt.success)
+                {
+                    grid->drawGrid(pathPrefix + std::to_string(attempt.seed) + ".png");
+                }
+            }
+            catch (...)
+            {
+                std::cerr << "Attempt with seed " << attempt.seed << " failed with an unexpected error\n";
+            }
+            attempt.duration = duration_cast<milliseconds>(high_resolution_clock::now() - start);
+        });
+    }
+    pool.wait();
+    return attempts;
+}
@@ -0,0 +1,37 @@
+#include "Progress.hpp"
+
+ProgressMonitor::ProgressMonitor(Observer observer, std::chrono::milliseconds interval, int scale):
+    buffer(interval, scale),
+    observer(observer),
+    interval(interval),
+    thread(&ProgressMonitor::watch, this)
+{}
+
+ProgressMonitor::~ProgressMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void ProgressMonitor::watch()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        //the mutex only guards stopping, the grid never touches it
+        bool stop = wake.wait_for(lock, interval, [&] { return stopping; });
+        lock.unlock();
+        const ProgressSnapshot* snapshot = buffer.latest();
+        if (snapshot != nullptr && !observer(*snapshot))
+        {
+            cancel();
+        }
+        if (stop)
+        { return; }
+        lock.lock();
+    }
+}
@@ -0,0 +1,359 @@
+#include "RegionWorker.hpp"
+
+#include <thread>
+#include <iostream>
+
+#include "Grid.hpp"
+#include "Error.hpp"
+
+template<uint Words>
+RegionWorker<Words>::RegionWorker(Grid<Words>& grid, RegionSync& sync, uint firstRow, uint endRow, uint firstCollapseRow, uint endCollapseRow, uint64_t seed):
+    grid(grid),
+    sync(sync),
+    firstField(firstRow * grid.width),
+    endField(endRow * grid.width),
+    firstCollapse(firstCollapseRow * grid.width),
+    endCollapse(endCollapseRow * grid.width),
+    randGen(seed),
+    entropies(endCollapse - firstCollapse, firstCollapse),
+    dirtyPositions(endField - firstField, firstField),
+    dirtyEntropies(endCollapse - firstCollapse, false),
+    startFields(grid.fields.begin() + firstField, grid.fields.begin() + endField),
+    startWeights(grid.weightSums.begin() + firstField, grid.weightSums.begin() + endField)
+{
+    queueEntropies();
+}
+
+template<uint Words>
+void RegionWorker<Words>::queueEntropies()
+{
+    for (uint iField = firstCollapse; iField < endCollapse; iField++)
+    {
+        if (grid.fields[iField].count() > 1)
+        {
+            entropies.update(iField, grid.calculateEntropy(iField));
+        }
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::connect(SpscQueue* fromAbove, SpscQueue* toAbove, SpscQueue* fromBelow, SpscQueue* toBelow)
+{
+    inbound[above] = fromAbove;
+    outbound[above] = toAbove;
+    inbound[below] = fromBelow;
+    outbound[below] = toBelow;
+}
+
+template<uint Words>
+inline typename RegionWorker<Words>::Field RegionWorker<Words>::load(uint field) const
+{
+    Field value;
+    for (uint i = 0; i < Words; i++)
+    {
+        value.words[i] = std::atomic_ref<uint64_t>(grid.fields[field].words[i]).load(std::memory_order_relaxed);
+    }
+    return value;
+}
+
+template<uint Words>
+inline void RegionWorker<Words>::store(uint field, const Field& value)
+{
+    for (uint i = 0; i < Words; i++)
+    {
+        std::atomic_ref<uint64_t>(grid.fields[field].words[i]).store(value.words[i], std::memory_order_relaxed);
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::send(uint field)
+{
+    int side = field < firstField ? above : below;
+    sync.pending.fetch_add(1);
+    if (!overflow[side].empty() || !outbound[side]->push(field))
+    {
+        overflow[side].push_back(field);
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::flushOverflow()
+{
+    for (int side : {above, below})
+    {
+        size_t sent = 0;
+        while (sent < overflow[side].size() && outbound[side]->push(overflow[side][sent]))
+        { sent++; }
+        overflow[side].erase(overflow[side].begin(), overflow[side].begin() + sent);
+    }
+}
+
+template<uint Words>
+long RegionWorker<Words>::receive()
+{
+    long received = 0;
+    uint field;
+    for (int side : {above, below})
+    {
+        while (inbound[side] != nullptr && inbound[side]->pop(field))
+        {
+            dirtyPositions.push(field);
+            received++;
+        }
+    }
+    return received;
+}
+
+template<uint Words>
+bool RegionWorker<Words>::hasInbound() const
+{
+    return (inbound[above] != nullptr && !inbound[above]->empty())
+        || (inbound[below] != nullptr && !inbound[below]->empty());
+}
+
+template<uint Words>
+typename RegionWorker<Words>::Field RegionWorker<Words>::combinedEdgeMask(uint iField, EdgeDirection edge)
+{
+    if (iField == Topology::NO_NEIGHBOUR)
+    {
+        return grid.allTiles;
+    }
+    if (owns(iField) && !grid.combinedEdgeMasks.empty())
+    {
+        Field mask = grid.combinedEdgeMasks[iField][edge]; //the cache of an owned field is only touched by this thread
+        if (mask.any())
+        {
+            COUNT(counters.maskCacheHits++);
+            return mask;
+        }
+        COUNT(counters.maskRecomputes++);
+        mask = grid.combineEdgeMasks(grid.fields[iField], edge);
+        grid.combinedEdgeMasks[iField][edge] = mask;
+        return mask;
+    }
+    COUNT(counters.maskRecomputes++);
+    return grid.combineEdgeMasks(owns(iField) ? grid.fields[iField] : load(iField), edge);
+}
+
+template<uint Words>
+bool RegionWorker<Words>::updateField(uint iField)
+{
+    const Field& before = grid.fields[iField];
+    if (before.count() == 1)
+    { return false; }
+    const std::array<uint, 4>& neighbours = grid.topology.neighboursOf(iField);
+    Field updated = before & combinedEdgeMask(neighbours[top], bottom) & combinedEdgeMask(neighbours[right], left)
+        & combinedEdgeMask(neighbours[left], right) & combinedEdgeMask(neighbours[bottom], top);
+    if (updated == before)
+    { return false; }
+    grid.removeWeights(iField, before.without(updated)); //the sums of an owned field are only touched by this thread
+    store(iField, updated);
+    grid.clearMaskCache(iField);
+    if (updated.none())
+    {
+        Position pos = grid.getPosition(iField);
+        grid.log << "Contradiction in Field " << pos.x << "|" << pos.y << " (" << iField << ")\n";
+        throw errors[Error::Code::contradiction];
+    }
+    return true;
+}
+
+template<uint Words>
+void RegionWorker<Words>::markChanged(uint iField)
+{
+    if (iField < firstCollapse || iField >= endCollapse || dirtyEntropies[iField - firstCollapse])
+    { return; }
+    dirtyEntropies[iField - firstCollapse] = true;
+    dirtyFields.push_back(iField);
+}
+
+template<uint Words>
+void RegionWorker<Words>::insertNeighbours(uint iField)
+{
+    for (EdgeDirection dir : {top, right, left, bottom})
+    {
+        uint iNeighbour = grid.topology.neighbour(iField, dir);
+        if (iNeighbour == Topology::NO_NEIGHBOUR)
+        { continue; }
+        if (owns(iNeighbour))
+        {
+            dirtyPositions.push(iNeighbour);
+        }
+        else
+        {
+            send(iNeighbour);
+        }
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::propagate()
+{
+    while (!dirtyPositions.empty())
+    {
+        uint iField = dirtyPositions.pop();
+        COUNT(counters.updateCalls++);
+        if (updateField(iField))
+        {
+            COUNT(counters.updateChanges++);
+            COUNT(counters.propagatedSingletons += grid.fields[iField].count() == 1);
+            markChanged(iField);
+            insertNeighbours(iField);
+        }
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::updateEntropies()
+{
+    for (uint iField : dirtyFields)
+    {
+        dirtyEntropies[iField - firstCollapse] = false;
+        if (grid.fields[iField].count() <= 1)
+        {
+            entropies.remove(iField);
+        }
+        else
+        {
+            COUNT(counters.entropyRecomputes++);
+            entropies.update(iField, grid.calculateEntropy(iField));
+        }
+    }
+    dirtyFields.clear();
+}
+
+template<uint Words>
+int RegionWorker<Words>::collapseOne()
+{
+    updateEntropies();
+    if (entropies.empty())
+    { return -1; }
+    uint iField = entropies.top().second;
+    store(iField, grid.collapseField(iField, randGen));
+    COUNT(counters.decisions++);
+    grid.clearMaskCache(iField);
+    markChanged(iField);
+    return iField;
+}
+
+// the owned fields go back to what they were when the regions started. The other strips may have narrowed their fields
+// against the old ones, which only makes them stricter, so propagating the border rows against them again is enough.
+// Other strips may read a field while it widens, a torn read then lies between the old and the new domain, again only stricter
+template<uint Words>
+void RegionWorker<Words>::restart()
+{
+    for (uint iField = firstField; iField < endField; iField++)
+    {
+        store(iField, startFields[iField - firstField]);
+        grid.weightSums[iField] = startWeights[iField - firstField];
+        grid.clearMaskCache(iField);
+    }
+    randGen.seed(randGen());
+    sync.pending.fetch_sub(received);
+    received = 0;
+    dirtyPositions.clear();
+    std::fill(dirtyEntropies.begin(), dirtyEntropies.end(), false);
+    dirtyFields.clear();
+    entropies.resize(endCollapse - firstCollapse);
+    queueEntropies();
+    for (uint iField = firstField; iField < firstField + grid.width; iField++)
+    {
+        dirtyPositions.push(iField);
+    }
+    for (uint iField = endField - grid.width; iField < endField; iField++)
+    {
+        dirtyPositions.push(iField);
+    }
+    propagate();
+}
+
+template<uint Words>
+void RegionWorker<Words>::work()
+{
+    while (true)
+    {
+        if (sync.failed.load(std::memory_order_relaxed) || (sync.cancel != nullptr && sync.cancel->load(std::memory_order_relaxed)))
+        {
+            sync.failed = true;
+            return;
+        }
+        flushOverflow();
+        received += receive();
+        if (received > 0)
+        {
+            propagate();
+            sync.pending.fetch_sub(received); //after the fields handed on by propagate() were counted
+            received = 0;
+            continue;
+        }
+        int collapsed = collapseOne();
+        if (collapsed != -1)
+        {
+            insertNeighbours(collapsed);
+            propagate();
+            continue;
+        }
+        if (!overflow[above].empty() || !overflow[below].empty())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        //nothing left to do here, done once every region is idle and nothing is in flight
+        sync.idle.fetch_add(1);
+        while (true)
+        {
+            if (sync.failed.load(std::memory_order_relaxed))
+            { return; }
+            if (hasInbound())
+            {
+                sync.idle.fetch_sub(1);
+                break;
+            }
+            if (sync.idle.load() == sync.workers && sync.pending.load() == 0)
+            { return; }
+            std::this_thread::yield();
+        }
+    }
+}
+
+template<uint Words>
+void RegionWorker<Words>::run()
+{
+    while (true)
+    {
+        try
+        {
+            //a retry starts with propagating its borders, which can run into a contradiction as well
+            if (retries > 0)
+            {
+                restart();
+            }
+            work();
+            return;
+        }
+        catch (Error err)
+        {
+            if (err.code != Error::Code::contradiction)
+            {
+                std::cerr << err.message << "\n";
+                sync.failed = true;
+                return;
+            }
+            sync.stripFailures.fetch_add(1, std::memory_order_relaxed);
+            if (retries == STRIP_RETRIES)
+            {
+                sync.failed = true;
+                return;
+            }
+            retries++;
+        }
+    }
+}
+
+template class RegionWorker<1>;
+template class RegionWorker<2>;
+template class RegionWorker<4>;
+template class RegionWorker<8>;
+template class RegionWorker<16>;
+template class RegionWorker<32>;
+template class RegionWorker<64>;
@@ -0,0 +1,69 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount < 1)
+    { threadCount = 1; }
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers.emplace_back([this] { work(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    allDone.wait(lock, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+bool ThreadPool::waitFor(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    return allDone.wait_for(lock, timeout, [this] { return jobs.empty() && activeJobs == 0; });
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            { return; } //stopping
+            job = std::move(jobs.front());
+            jobs.pop();
+            activeJobs++;
+        }
+        job();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            activeJobs--;
+            if (jobs.empty() && activeJobs == 0)
+            { allDone.notify_all(); }
+        }
+    }
+}
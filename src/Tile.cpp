@@ -1,5 +1,11 @@
 #include "Tile.hpp"
 
+#include <fstream>
+#include <filesystem>
+#include <unordered_map>
+
+#include "GridImageWriter.hpp"
+
 
 //using namespace png;
 
@@ -23,8 +29,17 @@
 // }
 
 
-Tile Tile::errorTile("tiles/Error.png", "Error", 0);
-Tile Tile::unknownTile("tiles/Unknown.png", "Unknown", 0);
+const Tile& Tile::getErrorTile()
+{
+    static Tile errorTile("tiles/Error.png", "Error", 0);
+    return errorTile;
+}
+
+const Tile& Tile::getUnknownTile()
+{
+    static Tile unknownTile("tiles/Unknown.png", "Unknown", 0);
+    return unknownTile;
+}
 
 
 
@@ -39,6 +54,7 @@ Tile::Tile(const std::string path, std::string name, int weight):
     edges(TileEdge::getEdges(image)),
     weight(weight)
 {
+    readEdgeLabels(std::filesystem::path(path).replace_extension(".edges"));
     image.write("tiles/generated/" + name + ".png");
 }
 
@@ -51,6 +67,14 @@ Tile::Tile(Image image, std::string name, int weight):
     image.write("tiles/generated/" + name + ".png");
 }
 
+Tile::Tile(Image image, std::string name, int weight, const std::array<TileEdge, 4>& edges, const std::array<std::vector<uint64_t>, 4>& edgeMasks):
+    image(image),
+    name(name),
+    edges(edges),
+    edgeMasks(edgeMasks),
+    weight(weight)
+{}
+
 Tile::Tile(const Tile& other):
     image(other.image),
     name(other.name),
@@ -76,30 +100,66 @@ void Tile::matchTiles(std::vector<std::unique_ptr<Tile>>& tiles)
 {
     if (tiles.size() > MAX_TILES)
     {
-        throw std::string("More tiles (") + std::to_string(tiles.size()) + ") than slots in the bitset, need to adjust the constant in Tile.hpp";
+        throw std::string("More tiles (") + std::to_string(tiles.size()) + ") than slots in the widest domain, need to adjust the constant in Tile.hpp";
     }
+    uint words = (tiles.size() + 63) / 64;
+    //the tiles with each edge id per direction, a mask is then the bucket of the opposite direction with the same id
+    std::array<std::unordered_map<int, std::vector<uint64_t>>, 4> buckets;
     for (uint i = 0; i < tiles.size(); i++)
     {
-        for (uint j = i; j < tiles.size(); j++)
+        for (uint edge = 0; edge < 4; edge++)
         {
-            for (uint edge = 0; edge < 4; edge++)
+            std::vector<uint64_t>& bucket = buckets[edge][tiles[i]->edges[edge].getId()];
+            if (bucket.empty())
+            {
+                bucket.assign(words, 0);
+            }
+            bucket[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+    for (auto& tile : tiles)
+    {
+        for (uint edge = 0; edge < 4; edge++)
+        {
+            auto& matching = buckets[3 - edge];
+            auto it = matching.find(tile->edges[edge].getId());
+            if (it == matching.end())
+            {
+                tile->edgeMasks[edge].assign(words, 0);
+            }
+            else
             {
-                uint oppositeEdge = 3 - edge;
-                if (tiles[i]->edges[edge] == tiles[j]->edges[oppositeEdge])
-                {
-                    tiles[i]->edgeMasks[edge].set(j);
-                    tiles[j]->edgeMasks[oppositeEdge].set(i);
-                }
+                tile->edgeMasks[edge] = it->second;
             }
         }
     }
 }
 
 
+void Tile::readEdgeLabels(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    { return; }
+    for (EdgeDirection edge : {top, left, right, bottom})
+    {
+        std::string label;
+        if (!(file >> label))
+        {
+            throw std::string("Expected 4 edge labels (top left right bottom) in ") + path;
+        }
+        if (label != "-")
+        {
+            edges[edge] = TileEdge::fromLabel(label);
+        }
+    }
+}
+
 void Tile::addRotations(std::vector<std::unique_ptr<Tile>>& tiles, int rotations, bool mirror) const
 {
     assert(rotations < 4);
     Image lastRotation = image;
+    std::array<TileEdge, 4> lastEdges = edges;
     for (int i = 0; i < rotations; i++)
     {
         Image rotatedImage(image.get_height(), image.get_width()); //switch width and height
@@ -110,7 +170,18 @@ void Tile::addRotations(std::vector<std::unique_ptr<Tile>>& tiles, int rotations
                 rotatedImage[x][image.get_height() - y - 1] = lastRotation[y][x];
             }
         }
-        tiles.push_back(std::unique_ptr<Tile> (new Tile(rotatedImage, name + "Rotated" + std::to_string(i+1), weight)));
+        std::unique_ptr<Tile> rotated(new Tile(rotatedImage, name + "Rotated" + std::to_string(i+1), weight));
+        //labelled edges turn with the tile, the others were just taken from the rotated pixels
+        std::array<TileEdge, 4> turnedEdges = {lastEdges[left], lastEdges[bottom], lastEdges[top], lastEdges[right]};
+        for (uint edge = 0; edge < 4; edge++)
+        {
+            if (turnedEdges[edge].isLabel())
+            {
+                rotated->edges[edge] = turnedEdges[edge];
+            }
+        }
+        lastEdges = rotated->edges;
+        tiles.push_back(std::move(rotated));
         lastRotation = rotatedImage;
     }
     if (mirror)
@@ -129,34 +200,19 @@ void Tile::addRotations(std::vector<std::unique_ptr<Tile>>& tiles, int rotations
     }
 }
     
-const std::bitset<MAX_TILES>& Tile::getEdgeMask(EdgeDirection edge) const
+const std::vector<uint64_t>& Tile::getEdgeMask(EdgeDirection edge) const
 {
     return edgeMasks[edge];
 }
 
 
-void Tile::drawGrid(std::vector<std::vector<const Tile*>>& tiles)
+void Tile::drawGrid(std::vector<std::vector<const Tile*>>& tiles, const std::string& path)
 {
-    Image gridImage(tiles[0][0]->image.get_width() * tiles[0].size(), tiles[0][0]->image.get_height() * tiles.size());
-    for (uint gridRow = 0; gridRow < tiles.size(); gridRow++)
-    {
-        for (uint gridColumn = 0; gridColumn < tiles[gridRow].size(); gridColumn++)
-        {
-            const Image& tileImage = tiles[gridRow][gridColumn]->image;
-            uint gridRowPixel = gridRow * tileImage.get_height();
-            uint gridColumnPixel = gridColumn * tileImage.get_width();
-            for (uint tileRow = 0; tileRow < tileImage.get_height(); tileRow++)
-            {
-                for (uint tileColumn = 0; tileColumn < tileImage.get_width(); tileColumn++)
-                {
-                    uint y = gridRowPixel + tileRow;
-                    uint x = gridColumnPixel + tileColumn;
-                    gridImage[y][x] = tileImage[tileRow][tileColumn];
-                }
-            }
-        }
-    }
-    gridImage.write("result.png");
+    const Image& first = tiles[0][0]->image;
+    GridImageWriter writer(tiles.size(), tiles[0].size(), first.get_height(), first.get_width(), [&](int y, std::vector<const Tile*>& row) {
+        row = tiles[y];
+    });
+    writer.write(path);
 }
     
 // void Tile::setEdgeMask(EdgeDirection edge)
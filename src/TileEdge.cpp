@@ -1,38 +1,84 @@
 #include "TileEdge.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+
 using namespace png;
 
-std::vector<TileEdge> TileEdge::existingEdges;
+std::unordered_map<std::string, int> TileEdge::existingEdges;
+std::vector<std::pair<std::string, int>> TileEdge::toleratedEdges;
+int TileEdge::edgeCount = 0;
+int TileEdge::colourTolerance = 0;
 
-TileEdge::TileEdge(const std::vector<png::rgb_pixel>& pixels):
-pixels(pixels)
+int TileEdge::intern(const std::string& key)
 {
-    bool match = false;
-    for (uint iEdge = 0; iEdge < existingEdges.size(); iEdge++)
+    auto [it, added] = existingEdges.emplace(key, edgeCount);
+    edgeCount += added;
+    return it->second;
+}
+
+int TileEdge::findTolerated(const std::string& key)
+{
+    for (const auto& [other, id] : toleratedEdges)
     {
-        match = true;
-        for (uint i = 0; i < pixels.size(); i++)
-        {
-            if (pixels[i] != existingEdges[iEdge].pixels.at(i))
-            {
-                match = false;
-                break;
-            }
-        }
-        if (match)
+        if (other.size() != key.size())
+        { continue; }
+        bool close = true;
+        for (uint i = 1; close && i < key.size(); i++)
         {
-            existingEdgeIndex = iEdge;
-            break;
+            close = std::abs(int(uint8_t(key[i])) - int(uint8_t(other[i]))) <= colourTolerance;
         }
+        if (close)
+        { return id; }
+    }
+    return -1;
+}
+
+TileEdge::TileEdge(const std::vector<png::rgb_pixel>& pixels)
+{
+    std::string key(1 + pixels.size() * 3, 'p');
+    for (uint i = 0; i < pixels.size(); i++)
+    {
+        key[1 + i * 3] = pixels[i].red;
+        key[2 + i * 3] = pixels[i].green;
+        key[3 + i * 3] = pixels[i].blue;
+    }
+    auto known = existingEdges.find(key);
+    if (known != existingEdges.end())
+    {
+        existingEdgeIndex = known->second;
+        return;
     }
-    if (!match)
+    //a new pixel sequence: with a tolerance it joins the first edge it is close to, the exact key is remembered
+    //so repeated edges don't scan again
+    int tolerated = colourTolerance > 0 ? findTolerated(key) : -1;
+    if (tolerated >= 0)
     {
-        existingEdgeIndex = existingEdges.size();
-        existingEdges.push_back(*this);
+        existingEdges.emplace(key, tolerated);
+        existingEdgeIndex = tolerated;
+        return;
     }
+    existingEdgeIndex = intern(key);
+    toleratedEdges.emplace_back(key, existingEdgeIndex);
+}
+
+TileEdge::TileEdge(int id):
+existingEdgeIndex(id)
+{}
+
+TileEdge TileEdge::fromLabel(const std::string& label)
+{
+    TileEdge edge(intern("l" + label));
+    edge.labelled = true;
+    return edge;
+}
+
+void TileEdge::setColourTolerance(int tolerance)
+{
+    colourTolerance = std::clamp(tolerance, 0, 255);
 }
 
-std::array<TileEdge, 4> TileEdge::getEdges(png::image<png::rgb_pixel> image)
+std::array<TileEdge, 4> TileEdge::getEdges(const png::image<png::rgb_pixel>& image)
 {
     std::vector<png::rgb_pixel> edgePixels[4];
     for (uint x = 0; x < image.get_width(); x++)
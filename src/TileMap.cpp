@@ -0,0 +1,145 @@
+#include "TileMap.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "GridImageWriter.hpp"
+
+static_assert(sizeof(TileMapHeader) % 8 == 0, "the cells have to start aligned");
+
+// truncating UNDECIDED_TILE and CONTRADICTION_TILE to the width of a cell gives their cell values
+template<typename Cell>
+static int decode(Cell cell)
+{
+    Cell undecided = Cell(UNDECIDED_TILE);
+    Cell contradiction = Cell(CONTRADICTION_TILE);
+    return cell == undecided ? UNDECIDED_TILE : cell == contradiction ? CONTRADICTION_TILE : cell;
+}
+
+template<typename Cell>
+static void writeCells(std::ofstream& stream, int height, int width, TileRowSource& rowSource)
+{
+    std::vector<int> row(width);
+    std::vector<Cell> cells(width);
+    for (int y = 0; y < height; y++)
+    {
+        rowSource(y, row);
+        for (int x = 0; x < width; x++)
+        {
+            cells[x] = Cell(row[x]);
+        }
+        stream.write(reinterpret_cast<const char*>(cells.data()), width * sizeof(Cell));
+    }
+}
+
+void writeTileMap(const std::string& path, int height, int width, uint tileCount, TileRowSource rowSource)
+{
+    TileMapHeader header = {};
+    std::memcpy(header.magic, TILE_MAP_MAGIC, 4);
+    header.version = TILE_MAP_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tileCount = tileCount;
+    header.cellBytes = tileCount <= 254 ? 1 : 2;
+    std::ofstream stream(path, std::ios::binary);
+    if (!stream.is_open())
+    {
+        throw std::string("Could not write the tile map ") + path;
+    }
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (header.cellBytes == 1)
+    {
+        writeCells<uint8_t>(stream, height, width, rowSource);
+    }
+    else
+    {
+        writeCells<uint16_t>(stream, height, width, rowSource);
+    }
+    if (!stream)
+    {
+        throw std::string("Could not write the tile map ") + path;
+    }
+}
+
+TileMap::TileMap(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        throw std::string("Could not open the tile map ") + path;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(TileMapHeader))
+    {
+        close(fd);
+        throw std::string(path) + " is no tile map";
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::string("Could not map the tile map ") + path;
+    }
+    data = static_cast<const char*>(mapping);
+    size = info.st_size;
+    header = reinterpret_cast<const TileMapHeader*>(data);
+    if (std::memcmp(header->magic, TILE_MAP_MAGIC, 4) != 0 || header->version != TILE_MAP_VERSION
+        || (header->cellBytes != 1 && header->cellBytes != 2)
+        || size != sizeof(TileMapHeader) + (size_t) header->width * header->height * header->cellBytes)
+    {
+        munmap(const_cast<char*>(data), size);
+        throw std::string(path) + " is no tile map of this version";
+    }
+}
+
+TileMap::~TileMap()
+{
+    munmap(const_cast<char*>(data), size);
+}
+
+int TileMap::getTile(int x, int y) const
+{
+    size_t i = (size_t) y * header->width + x;
+    if (header->cellBytes == 1)
+    {
+        return decode(static_cast<const uint8_t*>(getCells())[i]);
+    }
+    return decode(static_cast<const uint16_t*>(getCells())[i]);
+}
+
+void TileMap::drawViewport(const std::vector<Tile>& tiles, int left, int top, int width, int height, const std::string& path) const
+{
+    if (tiles.size() != header->tileCount)
+    {
+        throw std::string("The tile map was generated with ") + std::to_string(header->tileCount) + " tiles, not "
+            + std::to_string(tiles.size());
+    }
+    if (left < 0 || top < 0 || width < 1 || height < 1 || left + width > getWidth() || top + height > getHeight())
+    {
+        throw std::string("The viewport is not within the ") + std::to_string(getWidth()) + "x" + std::to_string(getHeight()) + " map";
+    }
+    const Image& first = tiles[0].getImage();
+    GridImageWriter writer(height, width, first.get_height(), first.get_width(), [&](int y, std::vector<const Tile*>& row) {
+        for (int x = 0; x < width; x++)
+        {
+            int tile = getTile(left + x, top + y);
+            if (tile == UNDECIDED_TILE)
+            {
+                row[x] = &Tile::getUnknownTile();
+            }
+            else if (tile == CONTRADICTION_TILE || tile >= (int) tiles.size())
+            {
+                row[x] = &Tile::getErrorTile();
+            }
+            else
+            {
+                row[x] = &tiles[tile];
+            }
+        }
+    });
+    writer.write(path);
+}
@@ -0,0 +1,119 @@
+#include "Tileset.hpp"
+
+#include <array>
+#include <fstream>
+#include <filesystem>
+
+#include "TilesetCache.hpp"
+
+struct TileSource
+{
+    const char* path;
+    const char* name;
+    int weight;
+    int rotations;
+};
+
+// the order is the order of the flags in a tileset file
+const std::array<TileSource, 8> TILE_SOURCES = {{
+    {"tiles/GreenT.png", "GreenT", 1, 3},
+    {"tiles/GreenStraight.png", "GreenStraight", 1, 1},
+    {"tiles/GreenCurve.png", "GreenCurve", 1, 3},
+    {"tiles/BlueT.png", "BlueT", 1, 3},
+    {"tiles/BlueStraight.png", "BlueStraight", 1, 1},
+    {"tiles/BlueCross.png", "BlueCross", 1, 0},
+    {"tiles/Crossing.png", "Crossing", 1, 1},
+    {"tiles/Clear.png", "Clear", 5, 0}
+}};
+
+// 'y' or 'n' for every tile source
+std::string readSelection(const std::string& tilesetPath)
+{
+    std::string selection(TILE_SOURCES.size(), 'y');
+    if (!tilesetPath.empty())
+    {
+        std::ifstream tileset;
+        tileset.open(tilesetPath, std::ifstream::in);
+
+        for (unsigned int i = 0; i < selection.size(); i++)
+        {
+            selection[i] = tileset.get() == 'y' ? 'y' : 'n';
+        }
+    }
+    return selection;
+}
+
+std::vector<std::unique_ptr<Tile>> loadTiles(const std::string& tilesetPath)
+{
+    std::vector<std::unique_ptr<Tile>> tilesPtrs;
+    for (const TileSource& source : TILE_SOURCES)
+    {
+        tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile(source.path, source.name, source.weight)));
+    }
+
+    std::string selection = readSelection(tilesetPath);
+    for (int i = tilesPtrs.size() - 1; i >= 0; i--)
+    {
+        if (selection[i] == 'y')
+        {
+            tilesPtrs[i]->addRotations(tilesPtrs, TILE_SOURCES[i].rotations);
+        }
+        else
+        {
+            tilesPtrs.erase(tilesPtrs.begin() + i);
+        }
+    }
+    return tilesPtrs;
+}
+
+std::vector<Tile> matchTileset(std::vector<std::unique_ptr<Tile>>& tilesPtrs)
+{
+    Tile::matchTiles(tilesPtrs);
+
+    std::vector<Tile> tiles;
+    tiles.reserve(tilesPtrs.size());
+    for (auto& tilePtr : tilesPtrs)
+    {
+        tiles.push_back(Tile(*tilePtr));
+    }
+
+    return tiles;
+}
+
+std::vector<Tile> createTiles(const std::string& tilesetPath)
+{
+    auto tilesPtrs = loadTiles(tilesetPath);
+    return matchTileset(tilesPtrs);
+}
+
+TilesetStamp tilesetStamp(const std::string& tilesetPath)
+{
+    TilesetStamp stamp;
+    stamp.selection = readSelection(tilesetPath);
+    stamp.colourTolerance = TileEdge::getColourTolerance();
+    for (const TileSource& source : TILE_SOURCES)
+    {
+        auto modified = std::filesystem::last_write_time(source.path).time_since_epoch().count();
+        stamp.newestSource = std::max<int64_t>(stamp.newestSource, modified);
+        std::filesystem::path labels = std::filesystem::path(source.path).replace_extension(".edges");
+        if (std::filesystem::exists(labels))
+        {
+            modified = std::filesystem::last_write_time(labels).time_since_epoch().count();
+            stamp.newestSource = std::max<int64_t>(stamp.newestSource, modified);
+        }
+    }
+    return stamp;
+}
+
+std::vector<Tile> createTiles(const std::string& tilesetPath, const std::string& cachePath)
+{
+    TilesetStamp stamp = tilesetStamp(tilesetPath);
+    std::vector<Tile> tiles;
+    if (loadTilesetCache(cachePath, stamp, tiles))
+    {
+        return tiles;
+    }
+    tiles = createTiles(tilesetPath);
+    writeTilesetCache(cachePath, stamp, tiles);
+    return tiles;
+}
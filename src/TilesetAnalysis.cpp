@@ -0,0 +1,225 @@
+#include "TilesetAnalysis.hpp"
+
+#include <bit>
+#include <algorithm>
+
+static const char* sideNames[4] = {"top", "left", "right", "bottom"};
+static const char* classNames[3] = {"first", "middle", "last"};
+
+static bool hasTile(const std::vector<uint64_t>& domain, uint tile)
+{
+    return (domain[tile / 64] >> (tile % 64)) & 1;
+}
+
+static bool intersects(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b)
+{
+    for (uint i = 0; i < a.size(); i++)
+    {
+        if (a[i] & b[i])
+        { return true; }
+    }
+    return false;
+}
+
+static uint countTiles(const std::vector<uint64_t>& domain)
+{
+    uint count = 0;
+    for (uint64_t word : domain)
+    {
+        count += std::popcount(word);
+    }
+    return count;
+}
+
+// the classes along an axis of n fields and which classes lie right before and after a field of each class
+struct Axis
+{
+    std::vector<AxisClass> classes;
+    std::array<std::vector<AxisClass>, 3> before;
+    std::array<std::vector<AxisClass>, 3> after;
+
+    Axis(int n, bool periodic)
+    {
+        if (periodic)
+        {
+            //every field lies between two others
+            classes = before[middleOnAxis] = after[middleOnAxis] = {middleOnAxis};
+            return;
+        }
+        auto add = [](std::vector<AxisClass>& list, AxisClass axisClass) {
+            if (std::find(list.begin(), list.end(), axisClass) == list.end())
+            { list.push_back(axisClass); }
+        };
+        //beyond the first and last three fields every middle field looks the same
+        for (int i = 0; i < n; i = i == 2 && n > 6 ? n - 3 : i + 1)
+        {
+            AxisClass axisClass = TilesetAnalysis::classOf(i, n);
+            add(classes, axisClass);
+            if (i > 0)
+            { add(before[axisClass], TilesetAnalysis::classOf(i - 1, n)); }
+            if (i < n - 1)
+            { add(after[axisClass], TilesetAnalysis::classOf(i + 1, n)); }
+        }
+    }
+};
+
+TilesetAnalysis analyseTileset(const std::vector<Tile>& tiles, int height, int width, bool periodic)
+{
+    TilesetAnalysis analysis;
+    analysis.height = height;
+    analysis.width = width;
+    analysis.periodic = periodic;
+    analysis.tileCount = tiles.size();
+    uint words = tiles[0].getEdgeMask(top).size();
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+    {
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            if (countTiles(tiles[iTile].getEdgeMask(static_cast<EdgeDirection>(dir))) == 0)
+            {
+                analysis.unmatchedEdges.push_back({iTile, static_cast<EdgeDirection>(dir)});
+            }
+        }
+    }
+
+    Axis rows(height, periodic);
+    Axis columns(width, periodic);
+    analysis.rowClasses = rows.classes;
+    analysis.columnClasses = columns.classes;
+    std::vector<uint64_t> allTiles(words, 0);
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+    {
+        allTiles[iTile / 64] |= uint64_t(1) << (iTile % 64);
+    }
+    for (auto& row : analysis.domains)
+    {
+        row.fill(std::vector<uint64_t>(words, 0));
+    }
+    for (AxisClass rowClass : rows.classes)
+    {
+        for (AxisClass columnClass : columns.classes)
+        {
+            analysis.domains[rowClass][columnClass] = allTiles;
+        }
+    }
+
+    //remove tiles that fit nothing next to them on some side until nothing changes
+    std::vector<uint64_t> neighbours(words);
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (AxisClass rowClass : rows.classes)
+        {
+            for (AxisClass columnClass : columns.classes)
+            {
+                std::vector<uint64_t>& domain = analysis.domains[rowClass][columnClass];
+                for (uint dir = 0; dir < 4; dir++)
+                {
+                    EdgeDirection edge = static_cast<EdgeDirection>(dir);
+                    bool vertical = edge == top || edge == bottom;
+                    const Axis& axis = vertical ? rows : columns;
+                    AxisClass axisClass = vertical ? rowClass : columnClass;
+                    const std::vector<AxisClass>& classes = edge == top || edge == left ? axis.before[axisClass] : axis.after[axisClass];
+                    if (classes.empty())
+                    { continue; }
+                    //a field of the class has its neighbour on that side in one of these classes, a tile has to fit into at least their union
+                    std::fill(neighbours.begin(), neighbours.end(), 0);
+                    for (AxisClass neighbourClass : classes)
+                    {
+                        const std::vector<uint64_t>& neighbourDomain = vertical ? analysis.domains[neighbourClass][columnClass]
+                            : analysis.domains[rowClass][neighbourClass];
+                        for (uint i = 0; i < words; i++)
+                        {
+                            neighbours[i] |= neighbourDomain[i];
+                        }
+                    }
+                    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+                    {
+                        if (hasTile(domain, iTile) && !intersects(tiles[iTile].getEdgeMask(edge), neighbours))
+                        {
+                            domain[iTile / 64] &= ~(uint64_t(1) << (iTile % 64));
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //the innermost class the size has, the middle one if there is one
+    auto inner = [](const Axis& axis) {
+        return std::find(axis.classes.begin(), axis.classes.end(), middleOnAxis) != axis.classes.end() ? middleOnAxis : firstOnAxis;
+    };
+    AxisClass innerRow = inner(rows);
+    AxisClass innerColumn = inner(columns);
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+    {
+        bool anywhere = false;
+        for (AxisClass rowClass : rows.classes)
+        {
+            for (AxisClass columnClass : columns.classes)
+            {
+                anywhere |= hasTile(analysis.domains[rowClass][columnClass], iTile);
+            }
+        }
+        if (!anywhere)
+        {
+            analysis.unplaceable.push_back(iTile);
+        }
+        else if (!hasTile(analysis.domains[innerRow][innerColumn], iTile))
+        {
+            analysis.borderOnly.push_back(iTile);
+        }
+    }
+    for (AxisClass rowClass : rows.classes)
+    {
+        for (AxisClass columnClass : columns.classes)
+        {
+            analysis.satisfiable &= countTiles(analysis.domains[rowClass][columnClass]) > 0;
+        }
+    }
+    return analysis;
+}
+
+bool TilesetAnalysis::prunes() const
+{
+    for (AxisClass rowClass : rowClasses)
+    {
+        for (AxisClass columnClass : columnClasses)
+        {
+            if (countTiles(domains[rowClass][columnClass]) < tileCount)
+            { return true; }
+        }
+    }
+    return false;
+}
+
+void TilesetAnalysis::print(const std::vector<Tile>& tiles, std::ostream& out) const
+{
+    out << tiles.size() << " tiles on " << width << "x" << height << " fields\n";
+    for (auto [iTile, edge] : unmatchedEdges)
+    {
+        out << "nothing fits the " << sideNames[edge] << " edge of " << tiles[iTile].getName() << "\n";
+    }
+    for (uint iTile : unplaceable)
+    {
+        out << tiles[iTile].getName() << " can't be placed anywhere\n";
+    }
+    for (uint iTile : borderOnly)
+    {
+        out << tiles[iTile].getName() << " can only be placed at the borders\n";
+    }
+    for (AxisClass rowClass : rowClasses)
+    {
+        for (AxisClass columnClass : columnClasses)
+        {
+            out << classNames[rowClass] << " row, " << classNames[columnClass] << " column: "
+                << countTiles(domains[rowClass][columnClass]) << " tiles possible\n";
+        }
+    }
+    if (!satisfiable)
+    {
+        out << "some fields can't hold any tile, no grid of this size can be completed\n";
+    }
+}
@@ -0,0 +1,164 @@
+#include "TilesetCache.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <unistd.h>
+
+// layout: CacheHeader, CacheTile[tileCount], uint64_t edge masks[tileCount][4][words], rgb pixels[tileCount][tileHeight][tileWidth]
+// every part starts 8 byte aligned, all values are in the byte order of the machine that wrote the file
+const char CACHE_MAGIC[4] = {'W', 'F', 'C', 'T'};
+const uint32_t CACHE_VERSION = 2; //increment whenever the layout changes
+
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t tileCount;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t words; //per edge mask
+    int32_t colourTolerance;
+    int64_t newestSource;
+    char selection[32];
+};
+
+static_assert(sizeof(png::rgb_pixel) == 3, "pixels are copied as packed rgb");
+
+struct CacheTile
+{
+    int32_t weight;
+    int32_t edgeIds[4];
+    char name[60]; //zero terminated
+};
+
+static size_t alignUp(size_t offset)
+{
+    return (offset + 7) & ~size_t(7);
+}
+
+static size_t masksOffset(const CacheHeader& header)
+{
+    return alignUp(sizeof(CacheHeader) + header.tileCount * sizeof(CacheTile));
+}
+
+static size_t pixelsOffset(const CacheHeader& header)
+{
+    return alignUp(masksOffset(header) + header.tileCount * 4 * header.words * sizeof(uint64_t));
+}
+
+static size_t fileSize(const CacheHeader& header)
+{
+    return pixelsOffset(header) + header.tileCount * header.tileHeight * header.tileWidth * 3;
+}
+
+static bool matches(const CacheHeader& header, const TilesetStamp& stamp)
+{
+    return std::memcmp(header.magic, CACHE_MAGIC, 4) == 0 && header.version == CACHE_VERSION
+        && header.newestSource == stamp.newestSource && header.colourTolerance == stamp.colourTolerance && stamp.selection.size() < sizeof(header.selection)
+        && stamp.selection == header.selection;
+}
+
+bool loadTilesetCache(const std::string& path, const TilesetStamp& stamp, std::vector<Tile>& tiles)
+{
+    //read in one go rather than mapped: the tiles own their pixels and masks (Tile, png::image) and the grids copy the masks
+    //again, so a mapping would only be copied out of as well. The file is a few KB, the saving is the decoding and matching
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    { return false; }
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (buffer.size() < sizeof(CacheHeader))
+    { return false; }
+    //the vector's storage is aligned for any fundamental type, so the masks can be read in place
+    const char* data = buffer.data();
+    const CacheHeader& header = *reinterpret_cast<const CacheHeader*>(data);
+    bool valid = matches(header, stamp) && fileSize(header) == buffer.size();
+    if (valid)
+    {
+        const CacheTile* records = reinterpret_cast<const CacheTile*>(data + sizeof(CacheHeader));
+        const uint64_t* masks = reinterpret_cast<const uint64_t*>(data + masksOffset(header));
+        const png::rgb_pixel* pixels = reinterpret_cast<const png::rgb_pixel*>(data + pixelsOffset(header));
+        tiles.clear();
+        tiles.reserve(header.tileCount);
+        for (uint iTile = 0; iTile < header.tileCount; iTile++)
+        {
+            const CacheTile& record = records[iTile];
+            std::array<std::vector<uint64_t>, 4> edgeMasks;
+            for (uint dir = 0; dir < 4; dir++)
+            {
+                const uint64_t* mask = masks + (iTile * 4 + dir) * header.words;
+                edgeMasks[dir].assign(mask, mask + header.words);
+            }
+            Image image(header.tileWidth, header.tileHeight);
+            for (uint y = 0; y < header.tileHeight; y++)
+            {
+                const png::rgb_pixel* row = pixels + (iTile * header.tileHeight + y) * header.tileWidth;
+                std::copy(row, row + header.tileWidth, image[y].begin());
+            }
+            std::array<TileEdge, 4> edges = {TileEdge(record.edgeIds[0]), TileEdge(record.edgeIds[1]),
+                TileEdge(record.edgeIds[2]), TileEdge(record.edgeIds[3])};
+            tiles.push_back(Tile(image, record.name, record.weight, edges, edgeMasks));
+        }
+    }
+    return valid;
+}
+
+void writeTilesetCache(const std::string& path, const TilesetStamp& stamp, const std::vector<Tile>& tiles)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.tileCount = tiles.size();
+    header.tileWidth = tiles[0].getImage().get_width();
+    header.tileHeight = tiles[0].getImage().get_height();
+    header.words = tiles[0].getEdgeMask(top).size();
+    header.newestSource = stamp.newestSource;
+    header.colourTolerance = stamp.colourTolerance;
+    if (stamp.selection.size() >= sizeof(header.selection))
+    {
+        throw std::string("Too many tile sources for the tileset cache");
+    }
+    std::strcpy(header.selection, stamp.selection.c_str());
+
+    std::vector<char> data(fileSize(header), 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    CacheTile* records = reinterpret_cast<CacheTile*>(data.data() + sizeof(CacheHeader));
+    uint64_t* masks = reinterpret_cast<uint64_t*>(data.data() + masksOffset(header));
+    png::rgb_pixel* pixels = reinterpret_cast<png::rgb_pixel*>(data.data() + pixelsOffset(header));
+    for (uint iTile = 0; iTile < tiles.size(); iTile++)
+    {
+        const Tile& tile = tiles[iTile];
+        if (tile.getName().size() >= sizeof(records[iTile].name))
+        {
+            throw std::string("Tile name \"") + tile.getName() + "\" too long for the tileset cache";
+        }
+        if (tile.getImage().get_width() != header.tileWidth || tile.getImage().get_height() != header.tileHeight)
+        {
+            throw std::string("Tile \"") + tile.getName() + "\" differs in size from the others";
+        }
+        records[iTile].weight = tile.getWeight();
+        std::strcpy(records[iTile].name, tile.getName().c_str());
+        for (uint dir = 0; dir < 4; dir++)
+        {
+            EdgeDirection edge = static_cast<EdgeDirection>(dir);
+            records[iTile].edgeIds[dir] = tile.getEdge(edge).getId();
+            std::copy(tile.getEdgeMask(edge).begin(), tile.getEdgeMask(edge).end(), masks + (iTile * 4 + dir) * header.words);
+        }
+        for (uint y = 0; y < header.tileHeight; y++)
+        {
+            const auto& row = tile.getImage()[y];
+            std::copy(row.begin(), row.end(), pixels + (iTile * header.tileHeight + y) * header.tileWidth);
+        }
+    }
+
+    //written next to the target and renamed, so a concurrent job never reads a half written file
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(data.data(), data.size());
+    file.close();
+    if (!file || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::string("Could not write the tileset cache ") + path;
+    }
+}
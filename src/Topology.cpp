@@ -0,0 +1,71 @@
+#include "Topology.hpp"
+
+Topology::Topology(int height, int width, bool periodic):
+    periodic(periodic)
+{
+    resize(height, width);
+}
+
+void Topology::resize(int newHeight, int newWidth)
+{
+    height = newHeight;
+    width = newWidth;
+    neighbours.resize(height * width);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            Position pos{.x = x, .y = y};
+            for (uint dir = 0; dir < 4; dir++)
+            {
+                Position neighbour = pos.get(static_cast<EdgeDirection>(dir));
+                if (periodic)
+                {
+                    neighbour.x = (neighbour.x + width) % width;
+                    neighbour.y = (neighbour.y + height) % height;
+                }
+                bool valid = neighbour.x >= 0 && neighbour.x < width && neighbour.y >= 0 && neighbour.y < height;
+                neighbours[y * width + x][dir] = valid ? neighbour.y * width + neighbour.x : NO_NEIGHBOUR;
+            }
+        }
+    }
+}
+
+VoxelTopology::VoxelTopology(int depth, int height, int width, bool periodic):
+    periodic(periodic)
+{
+    resize(depth, height, width);
+}
+
+void VoxelTopology::resize(int newDepth, int newHeight, int newWidth)
+{
+    depth = newDepth;
+    height = newHeight;
+    width = newWidth;
+    neighbours.resize(depth * height * width);
+    //[direction]: step along x, y and z, in the order of EdgeDirection and VoxelDirection
+    const int steps[VOXEL_DIRECTIONS][3] = {{0, -1, 0}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}};
+    for (int z = 0; z < depth; z++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                for (uint dir = 0; dir < VOXEL_DIRECTIONS; dir++)
+                {
+                    int nx = x + steps[dir][0];
+                    int ny = y + steps[dir][1];
+                    int nz = z + steps[dir][2];
+                    if (periodic)
+                    {
+                        nx = (nx + width) % width;
+                        ny = (ny + height) % height;
+                        nz = (nz + depth) % depth;
+                    }
+                    bool valid = nx >= 0 && nx < width && ny >= 0 && ny < height && nz >= 0 && nz < depth;
+                    neighbours[getIndex(x, y, z)][dir] = valid ? getIndex(nx, ny, nz) : Topology::NO_NEIGHBOUR;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,323 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+#include "Grid.hpp"
+#include "Tile.hpp"
+#include "Tileset.hpp"
+#include "Options.hpp"
+
+// reproducible timings of the whole pipeline, see README for the options
+// every run of a size uses its own fixed seed, so two builds collapse exactly the same grids
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchRow
+{
+    std::string tileset;
+    int size = 0;
+    int runs = 0;
+    int attempts = 0;
+    int contradictions = 0;
+    int backtracks = 0;
+    int stripFailures = 0; //see RunStats
+    // milliseconds, loading and matching once per tileset, the rest averaged over the runs
+    double load = 0;
+    double match = 0;
+    double setup = 0;
+    double collapse = 0;
+    double propagation = 0;
+    double render = 0;
+    GridCounters counters; //summed over all attempts, only with WFC_STATS
+
+    double solve() const { return setup + collapse + propagation; }
+    double contradictionRate() const { return attempts > 0 ? contradictions / (double) attempts : 0; }
+};
+
+double milliseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+std::string tilesetName(const std::string& path)
+{
+    return path.empty() ? "all" : path;
+}
+
+// a run collapses grids of the given size until one succeeds or the attempts are used up, the seeds of a run never overlap with the next one
+void benchSize(BenchRow& row, const std::vector<Tile>& tiles, GridSettings settings, uint64_t firstSeed, int attempts, bool render)
+{
+    std::unique_ptr<GridBase> grid; //made once and reset for every attempt, like a long running generator would
+    for (int run = 0; run < row.runs; run++)
+    {
+        for (int attempt = 0; attempt < attempts; attempt++)
+        {
+            uint64_t seed = firstSeed + (uint64_t) run * attempts + attempt;
+            auto start = Clock::now();
+            if (grid)
+            {
+                grid->reset(seed);
+            }
+            else
+            {
+                settings.seed = seed;
+                grid = makeGrid(tiles, row.size, row.size, settings);
+            }
+            row.setup += milliseconds(Clock::now() - start);
+            bool success = grid->run();
+            RunStats stats = grid->getStats();
+            row.collapse += milliseconds(stats.collapse);
+            row.propagation += milliseconds(stats.propagation);
+            row.backtracks += stats.backtracks;
+            row.stripFailures += stats.stripFailures;
+            row.counters += stats.counters;
+            row.attempts++;
+            if (success || attempt + 1 == attempts)
+            {
+                if (render)
+                {
+                    start = Clock::now();
+                    grid->drawGrid("bench.png");
+                    row.render += milliseconds(Clock::now() - start);
+                }
+                if (success)
+                { break; }
+            }
+            row.contradictions++;
+        }
+    }
+    row.setup /= row.runs;
+    row.collapse /= row.runs;
+    row.propagation /= row.runs;
+    row.render /= row.runs;
+}
+
+const char* CSV_HEADER = "tileset,size,runs,attempts,contradictions,contradictionRate,backtracks,stripFailures,loadMs,matchMs,setupMs,collapseMs,propagationMs,renderMs,solveMs";
+const char* COUNTERS_HEADER = ",decisions,propagatedSingletons,updateCalls,updateChanges,tileRemovals,maskCacheHits,maskRecomputes,entropyRecomputes,waves";
+
+// bucket counts of the wave size histogram separated by ';', see GridCounters::waves, without the empty buckets at the end
+std::string waveHistogram(const GridCounters& counters)
+{
+    int used = GridCounters::WAVE_BUCKETS;
+    while (used > 1 && counters.waves[used - 1] == 0)
+    { used--; }
+    std::string histogram;
+    for (int i = 0; i < used; i++)
+    {
+        if (i > 0)
+        { histogram += ";"; }
+        histogram += std::to_string(counters.waves[i]);
+    }
+    return histogram;
+}
+
+void writeCsv(std::ostream& out, const std::vector<BenchRow>& rows)
+{
+    out << CSV_HEADER << (GridCounters::enabled ? COUNTERS_HEADER : "") << "\n" << std::fixed << std::setprecision(3);
+    for (const BenchRow& row : rows)
+    {
+        out << row.tileset << "," << row.size << "," << row.runs << "," << row.attempts << "," << row.contradictions << ","
+            << row.contradictionRate() << "," << row.backtracks << "," << row.stripFailures << "," << row.load << "," << row.match << ","
+            << row.setup << "," << row.collapse << "," << row.propagation << "," << row.render << "," << row.solve();
+        if (GridCounters::enabled)
+        {
+            const GridCounters& c = row.counters;
+            out << "," << c.decisions << "," << c.propagatedSingletons << "," << c.updateCalls << "," << c.updateChanges << ","
+                << c.tileRemovals << "," << c.maskCacheHits << "," << c.maskRecomputes << "," << c.entropyRecomputes << ","
+                << waveHistogram(c);
+        }
+        out << "\n";
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<BenchRow>& rows)
+{
+    out << "[\n" << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        const BenchRow& row = rows[i];
+        out << "  {\"tileset\": \"" << row.tileset << "\", \"size\": " << row.size << ", \"runs\": " << row.runs
+            << ", \"attempts\": " << row.attempts << ", \"contradictions\": " << row.contradictions
+            << ", \"contradictionRate\": " << row.contradictionRate() << ", \"backtracks\": " << row.backtracks
+            << ", \"stripFailures\": " << row.stripFailures << ", \"loadMs\": " << row.load << ", \"matchMs\": " << row.match
+            << ", \"setupMs\": " << row.setup
+            << ", \"collapseMs\": " << row.collapse << ", \"propagationMs\": " << row.propagation
+            << ", \"renderMs\": " << row.render << ", \"solveMs\": " << row.solve();
+        if (GridCounters::enabled)
+        {
+            const GridCounters& c = row.counters;
+            std::string waves = waveHistogram(c);
+            std::replace(waves.begin(), waves.end(), ';', ',');
+            out << ", \"counters\": {\"decisions\": " << c.decisions << ", \"propagatedSingletons\": " << c.propagatedSingletons
+                << ", \"updateCalls\": " << c.updateCalls << ", \"updateChanges\": " << c.updateChanges
+                << ", \"tileRemovals\": " << c.tileRemovals << ", \"maskCacheHits\": " << c.maskCacheHits
+                << ", \"maskRecomputes\": " << c.maskRecomputes << ", \"entropyRecomputes\": " << c.entropyRecomputes
+                << ", \"waves\": [" << waves << "]}";
+        }
+        out << "}" << (i + 1 < rows.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+// solveMs of every (tileset, size) in a csv written by writeCsv
+std::map<std::pair<std::string, int>, double> readBaseline(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::string("Could not open baseline ") + path;
+    }
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> header = splitList(line);
+    std::map<std::string, size_t> columns;
+    for (size_t i = 0; i < header.size(); i++)
+    {
+        columns[header[i]] = i;
+    }
+    if (!columns.count("tileset") || !columns.count("size") || !columns.count("solveMs"))
+    {
+        throw std::string("Baseline ") + path + " lacks the tileset, size or solveMs column";
+    }
+    std::map<std::pair<std::string, int>, double> baseline;
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> cells = splitList(line);
+        if (cells.size() != header.size())
+        { continue; }
+        baseline[{cells[columns["tileset"]], atoi(cells[columns["size"]].c_str())}] = atof(cells[columns["solveMs"]].c_str());
+    }
+    return baseline;
+}
+
+// prints the change of every row against the baseline, returns how many got slower than the tolerance allows
+int compareBaseline(const std::vector<BenchRow>& rows, const std::map<std::pair<std::string, int>, double>& baseline, double tolerance)
+{
+    int regressions = 0;
+    std::cerr << std::fixed << std::setprecision(1);
+    for (const BenchRow& row : rows)
+    {
+        auto it = baseline.find({row.tileset, row.size});
+        if (it == baseline.end() || it->second <= 0)
+        {
+            std::cerr << row.tileset << " " << row.size << "x" << row.size << ": no baseline\n";
+            continue;
+        }
+        double change = row.solve() / it->second - 1;
+        bool regression = change > tolerance;
+        regressions += regression;
+        std::cerr << row.tileset << " " << row.size << "x" << row.size << ": " << row.solve() << "ms, baseline " << it->second
+            << "ms (" << (change >= 0 ? "+" : "") << change * 100 << "%)" << (regression ? " REGRESSION" : "") << "\n";
+    }
+    return regressions;
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+    parseArguments(argc, argv, args, options);
+
+    try
+    {
+        std::vector<int> sizes;
+        for (const std::string& size : splitList(options.count("sizes") ? options["sizes"] : "30,100,300"))
+        {
+            sizes.push_back(atoi(size.c_str()));
+        }
+        std::vector<std::string> tilesets = splitList(options.count("tilesets") ? options["tilesets"] : "");
+        uint64_t seed = options.count("seed") ? parseSeed(options["seed"]) : 1;
+        int runs = options.count("runs") ? std::max(atoi(options["runs"].c_str()), 1) : 5;
+        int attempts = options.count("attempts") ? std::max(atoi(options["attempts"].c_str()), 1) : 1;
+        bool render = !options.count("render") || options["render"] != "0";
+        double tolerance = options.count("tolerance") ? atof(options["tolerance"].c_str()) : 0.1;
+        std::string format = options.count("format") ? options["format"] : "csv";
+        if (format != "csv" && format != "json")
+        {
+            throw std::string("Unknown format \"") + format + "\", expected csv or json";
+        }
+
+        GridSettings settings = parseGridSettings(options);
+        settings.timePhases = true;
+        parseTileOptions(options);
+
+        //the grids log to std::cout, keep that out of the results
+        std::ostringstream gridLog;
+        std::streambuf* coutBuffer = std::cout.rdbuf(gridLog.rdbuf());
+
+        std::vector<BenchRow> rows;
+        for (size_t iTileset = 0; iTileset < tilesets.size(); iTileset++)
+        {
+            const std::string& tileset = tilesets[iTileset];
+            std::vector<Tile> tiles;
+            double load = 0, match = 0;
+            auto start = Clock::now();
+            if (options.count("tile-cache"))
+            {
+                //one cache file per tileset, the first run compiles it
+                tiles = createTiles(tileset, options["tile-cache"] + "_" + std::to_string(iTileset));
+                load = milliseconds(Clock::now() - start);
+            }
+            else
+            {
+                auto tilesPtrs = loadTiles(tileset);
+                load = milliseconds(Clock::now() - start);
+                start = Clock::now();
+                tiles = matchTileset(tilesPtrs);
+                match = milliseconds(Clock::now() - start);
+            }
+
+            for (int size : sizes)
+            {
+                BenchRow row;
+                row.tileset = tilesetName(tileset);
+                row.size = size;
+                row.runs = runs;
+                row.load = load;
+                row.match = match;
+                benchSize(row, tiles, settings, seed, attempts, render);
+                rows.push_back(row);
+                gridLog.str("");
+            }
+        }
+        std::cout.rdbuf(coutBuffer);
+
+        std::ofstream file;
+        if (options.count("out"))
+        {
+            file.open(options["out"]);
+        }
+        std::ostream& out = options.count("out") ? file : std::cout;
+        if (format == "csv")
+        {
+            writeCsv(out, rows);
+        }
+        else
+        {
+            writeJson(out, rows);
+        }
+
+        if (options.count("baseline"))
+        {
+            int regressions = compareBaseline(rows, readBaseline(options["baseline"]), tolerance);
+            if (regressions > 0)
+            {
+                std::cerr << regressions << " of " << rows.size() << " results are more than " << tolerance * 100 << "% slower than the baseline\n";
+                return 1;
+            }
+        }
+    }
+    catch (std::string s)
+    {
+        std::cerr << s << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -7,13 +7,24 @@
 #include <stack>
 #include <functional>
 #include <memory>
+#include <map>
+#include <string>
 
 #include <algorithm>
 #include <chrono>
+#include <thread>
 
 #include "Grid.hpp"
 #include "Image.hpp"
 #include "Tile.hpp"
+#include "Tileset.hpp"
+#include "Options.hpp"
+#include "ParallelRunner.hpp"
+#include "ChunkedGenerator.hpp"
+#include "GenerationService.hpp"
+#include "OverlappingModel.hpp"
+#include "TileMap.hpp"
+#include "TilesetAnalysis.hpp"
 
 
 using namespace std;
@@ -39,91 +50,234 @@ using namespace std::chrono;
 //     return os;
 // }
 
-std::vector<Tile> createTiles(int argc, char *argv[])
+int main(int argc, char *argv[])
 {
-    const int tileCount = 8;
-    std::vector<std::unique_ptr<Tile>> tilesPtrs;
-    
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/GreenT.png", "GreenT")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/GreenStraight.png", "GreenStraight")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/GreenCurve.png", "GreenCurve")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/BlueT.png", "BlueT")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/BlueStraight.png", "BlueStraight")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/BlueCross.png", "BlueCross")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/Crossing.png", "Crossing")));
-    tilesPtrs.push_back(std::unique_ptr<Tile>(new Tile("tiles/Clear.png", "Clear", 5)));
-    std::array<int, tileCount> tileRotations = {3, 1, 3, 3, 1, 0, 1, 0};
+    // Image image;
+    // image.copyImage();
+    int width = 30, height = 30;
+    int runs = 1;
+    std::vector<std::string> args;
+    std::map<std::string, std::string> options;
+    parseArguments(argc, argv, args, options);
     
-    std::array<bool, tileCount> enabledTiles;
-    for (unsigned int i = 0; i < enabledTiles.size(); i++)
+    if (args.size() >= 2)
     {
-        enabledTiles[i] = true;
+        width = atoi(args[0].c_str());
+        height = atoi(args[1].c_str());
+    }
+    if (args.size() >= 3)
+    {
+        runs = atoi(args[2].c_str());
     }
     
-    if (argc >= 5)
+    if (options.count("serve"))
     {
-        std::ifstream tileset;
-        tileset.open(argv[4], std::ifstream::in);
-        
-        for (unsigned int i = 0; i < enabledTiles.size(); i++)
+        try
+        {
+            parseTileOptions(options);
+            int threads = options.count("threads") ? atoi(options["threads"].c_str()) : std::thread::hardware_concurrency();
+            GenerationService service(parseGridSettings(options), threads, options.count("tile-cache") ? options["tile-cache"] : "",
+                options.count("output-dir") ? options["output-dir"] : "");
+            for (const std::string& tileset : splitList(options.count("tilesets") ? options["tilesets"] : ""))
+            {
+                service.preload(tileset);
+            }
+            if (options["serve"].empty())
+            {
+                service.serve(0, 1);
+            }
+            else
+            {
+                service.listen(options["serve"]);
+            }
+        }
+        catch (std::string s)
         {
-            enabledTiles[i] = tileset.get() == 'y';
+            std::cerr << s << '\n';
+            return 1;
         }
+        return 0;
     }
     
-    for (int i = tilesPtrs.size() - 1; i >= 0; i--)
+    std::string tilesetPath = args.size() >= 4 ? args[3] : "";
+    std::vector<Tile> tiles;
+    try
     {
-        if (enabledTiles[i])
+        parseTileOptions(options);
+        if (options.count("overlap"))
         {
-            tilesPtrs[i]->addRotations(tilesPtrs, tileRotations[i]);
+            int patternSize = options.count("pattern-size") ? atoi(options["pattern-size"].c_str()) : 3;
+            int symmetry = options.count("symmetry") ? atoi(options["symmetry"].c_str()) : 8;
+            bool periodicInput = !options.count("periodic-input") || options["periodic-input"] != "0";
+            tiles = createPatternTiles(options["overlap"], patternSize, symmetry, periodicInput);
+            std::cout << tiles.size() << " patterns in " << options["overlap"] << "\n";
         }
         else
         {
-            tilesPtrs.erase(tilesPtrs.begin() + i);
+            tiles = options.count("tile-cache") ? createTiles(tilesetPath, options["tile-cache"]) : createTiles(tilesetPath);
         }
     }
-    
-    Tile::matchTiles(tilesPtrs);
-    
-    std::vector<Tile> tiles;
-    tiles.reserve(tilesPtrs.size());
-    for (auto& tilePtr : tilesPtrs)
+    catch (std::string s)
     {
-        tiles.push_back(Tile(*tilePtr));
+        std::cerr << s << '\n';
+        return 1;
     }
     
-    return tiles;
-}
-
-
-int main(int argc, char *argv[])
-{
-    // Image image;
-    // image.copyImage();
-    int width = 30, height = 30;
-    int runs = 1;
-    
-    if (argc >= 3)
+    if (options.count("analyse"))
     {
-        width = atoi(argv[1]);
-        height = atoi(argv[2]);
+        //the grid is made with height and width swapped, see makeGrid below
+        TilesetAnalysis analysis = analyseTileset(tiles, width, height, options.count("periodic") && options["periodic"] != "0");
+        analysis.print(tiles, std::cout);
+        return analysis.satisfiable ? 0 : 1;
     }
-    if (argc >= 4)
+    
+    if (options.count("render"))
     {
-        runs = atoi(argv[3]);
+        //a viewport of a map written with --map, by the tileset it was generated with
+        try
+        {
+            TileMap map(options["render"]);
+            std::vector<int> viewport = {0, 0, map.getWidth(), map.getHeight()};
+            if (options.count("viewport"))
+            {
+                std::vector<std::string> values = splitList(options["viewport"]);
+                if (values.size() != 4)
+                {
+                    throw std::string("Expected the viewport as x,y,width,height");
+                }
+                std::transform(values.begin(), values.end(), viewport.begin(), [](const std::string& value) { return atoi(value.c_str()); });
+            }
+            std::string out = options.count("out") ? options["out"] : "result.png";
+            map.drawViewport(tiles, viewport[0], viewport[1], viewport[2], viewport[3], out);
+            std::cout << "viewport written to " << out << "\n";
+        }
+        catch (std::string s)
+        {
+            std::cerr << s << '\n';
+            return 1;
+        }
+        return 0;
     }
     
-    auto tiles = createTiles(argc, argv);
-    
     std::chrono::milliseconds totalTime(0);
     try
     {
+        GridSettings settings = parseGridSettings(options);
+        uint64_t seed = high_resolution_clock::now().time_since_epoch().count();
+        if (options.count("seed"))
+        {
+            seed = parseSeed(options["seed"]);
+        }
+        int threads = options.count("threads") ? atoi(options["threads"].c_str()) : 1;
+        int attempts = options.count("attempts") ? atoi(options["attempts"].c_str()) : 1;
+        int chunkSize = options.count("chunk") ? atoi(options["chunk"].c_str()) : 0;
+        std::string mapPath = options.count("map") ? (options["map"].empty() ? "result.wfcmap" : options["map"]) : "";
+        auto output = [&](GridBase& result) {
+            if (mapPath.empty())
+            {
+                result.drawGrid();
+            }
+            else
+            {
+                result.writeTileMap(mapPath);
+            }
+        };
+        if (chunkSize > 0 && settings.periodic)
+        {
+            throw std::string("Chunks are matched to their neighbours, a chunked world can't wrap around with --periodic");
+        }
+        Constraints constraints;
+        if (options.count("constraints"))
+        {
+            if (chunkSize > 0 || threads > 1 || attempts > 1)
+            {
+                throw std::string("Constraints only apply to a single grid, without --chunk, --threads or --attempts");
+            }
+            constraints = readConstraints(options["constraints"], tiles);
+        }
+        //the observer runs on the thread of the monitor, printing never holds the grid up
+        std::unique_ptr<ProgressMonitor> monitor;
+        if (options.count("progress") || options.count("time-limit"))
+        {
+            if (chunkSize > 0 || threads > 1 || attempts > 1)
+            {
+                throw std::string("Progress and time limits only apply to a single grid, without --chunk, --threads or --attempts");
+            }
+            bool print = options.count("progress");
+            int interval = print && !options["progress"].empty() ? std::max(atoi(options["progress"].c_str()), 1) : print ? 1000 : 100;
+            std::chrono::duration<double> limit(options.count("time-limit") ? atof(options["time-limit"].c_str()) : 0);
+            monitor = std::make_unique<ProgressMonitor>([print, limit](const ProgressSnapshot& snapshot) {
+                if (print)
+                {
+                    std::cout << snapshot.decided << " of " << snapshot.height * snapshot.width << " fields decided after "
+                        << duration_cast<milliseconds>(snapshot.elapsed).count() << " milliseconds"
+                        << (snapshot.finished ? ", done" : "") << "\n";
+                }
+                return limit.count() <= 0 || snapshot.elapsed < limit;
+            }, std::chrono::milliseconds(interval), std::max(width, height) / 256); //only the counts are printed, keep the cells small
+            settings.progress = monitor->getBuffer();
+            settings.cancel = monitor->getCancel();
+        }
+        std::unique_ptr<ParallelRunner> runner;
+        std::unique_ptr<GridBase> grid; //reset for every run instead of allocated anew
+        if (chunkSize == 0 && (threads > 1 || attempts > 1))
+        {
+            runner = std::make_unique<ParallelRunner>(tiles, threads);
+        }
+        
         for (int i = 0; i < runs; i++)
         {
             auto start = high_resolution_clock::now();
+            uint64_t runSeed = seed + (uint64_t) i * attempts;
             
-            Grid grid(tiles, width, height);
-            grid.run();
+            if (chunkSize > 0)
+            {
+                ChunkedGenerator generator(tiles, width, height, chunkSize, settings, attempts);
+                int failedChunks = generator.run("chunk", runSeed);
+                std::cout << "chunks written to chunk_<y>_<x>.png, " << failedChunks << " of them with contradictions\n";
+            }
+            else if (!runner)
+            {
+                if (grid)
+                {
+                    grid->reset(runSeed);
+                }
+                else
+                {
+                    settings.seed = runSeed;
+                    grid = makeGrid(tiles, width, height, settings);
+                }
+                grid->applyConstraints(constraints);
+                if (!grid->run())
+                {
+                    std::cout << "drawing anyways\n";
+                }
+                output(*grid);
+            }
+            else if (options.count("batch"))
+            {
+                std::vector<Attempt> results = runner->batch(width, height, settings, runSeed, attempts, "result_");
+                int successes = 0;
+                for (const Attempt& attempt : results)
+                {
+                    successes += attempt.success;
+                }
+                std::cout << successes << " of " << attempts << " attempts succeeded, written to result_<seed>.png\n";
+            }
+            else
+            {
+                RaceResult result = runner->race(width, height, settings, runSeed, attempts);
+                std::cout << result.attemptsStarted << " attempts started, " << result.contradictions << " contradictions\n";
+                if (result.winner.success)
+                {
+                    std::cout << "seed " << result.winner.seed << " succeeded\n";
+                    output(*result.winner.grid);
+                }
+                else
+                {
+                    std::cout << "no attempt succeeded\n";
+                }
+            }
             
             auto stop = high_resolution_clock::now();
             auto duration = duration_cast<milliseconds>(stop - start);